@@ -0,0 +1,92 @@
+/**
+ * @file affinity.h
+ * @brief This file provides the placement of threads and pages on the NUMA
+ *        nodes: CPU pinning, first touch and a report of local pages.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef AFFINITY_H
+#define AFFINITY_H
+
+#include <stdbool.h>
+
+
+/**
+ * @brief Number of pages of its slice each thread looks up in
+ *        numa_balance_measure().
+ */
+#define NUMA_SAMPLE_PAGES 1024
+
+
+/** @brief Where the pages of a buffer lie, for the threads reading them. */
+struct numa_balance {
+    /** Pages on the NUMA node of the thread reading them. */
+    long long local;
+    /** Pages on another NUMA node. */
+    long long remote;
+    /** Pages not backed yet, or whose NUMA node could not be found. */
+    long long unknown;
+};
+
+
+/**
+ * @brief Pin every OpenMP thread of the calling process to a CPU of its own.
+ * @param rank: Rank of the process calling the function.
+ * @return `true` if all threads have been pinned; `false` otherwise.
+ *
+ * The processes of a node take consecutive blocks of the CPUs they are allowed
+ * to run on, one CPU for each thread; if the launcher has already bound each
+ * process to its own CPUs, the threads are spread over those. A pinned thread
+ * stays on the NUMA node its pages were first touched from. It is a collective
+ * operation: all processes have to call it.
+ */
+bool affinity_pin(int rank);
+
+/**
+ * @brief Back the pages of a buffer on the NUMA nodes of the OpenMP threads
+ *        that will use them.
+ * @param buffer: The buffer, whose pages have not been written yet.
+ * @param size:   Number of bytes in the buffer.
+ *
+ * Linux places a page on the node of the thread writing it first: each thread
+ * writes the pages of the same contiguous slice the counting kernels give it.
+ */
+void first_touch(void *buffer, long long size);
+
+/**
+ * @brief Find how many pages of a buffer lie on the NUMA node of the OpenMP
+ *        thread that reads them.
+ * @param buffer:  The buffer.
+ * @param size:    Number of bytes in the buffer.
+ * @param balance: Number of pages of each kind (output).
+ *
+ * Each thread takes the same slice of the buffer the counting kernels give it
+ * and looks up the node of up to #NUMA_SAMPLE_PAGES pages, evenly spread
+ * across the slice, with the `move_pages` system call.
+ */
+void numa_balance_measure(const void *buffer, long long size,
+                          struct numa_balance *balance);
+
+
+#endif /* AFFINITY_H */
@@ -0,0 +1,123 @@
+/**
+ * @file arena.h
+ * @brief This file provides the allocation of large buffers, backed by huge
+ *        pages and optionally pre-faulted, and the counting of page faults.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stdbool.h>
+
+
+/**
+ * @brief Size of a huge page: buffers at least this big are allocated with
+ *        huge_alloc() as whole huge pages.
+ */
+#define HUGE_PAGE_SIZE (2LL << 20)
+
+/** @brief Alignment of the buffers taken from an arena: a cache line. */
+#define ARENA_ALIGNMENT 64
+
+
+/** @brief Region of memory from which buffers are taken one after the other. */
+struct arena {
+    /** First byte of the region. */
+    char *base;
+    /** Number of bytes in the region. */
+    long long size;
+    /** Number of bytes already taken. */
+    long long used;
+};
+
+
+/** @brief Page faults taken by the calling process since it started. */
+struct page_faults {
+    /** Faults served without reading from disk, such as first touches. */
+    long long minor;
+    /** Faults that had to read from disk. */
+    long long major;
+};
+
+
+/**
+ * @brief Allocate a buffer, backed by huge pages if it is large enough.
+ * @param size:     Number of bytes to allocate.
+ * @param prefault: Whether to touch every page of the buffer right away, with
+ *                  as many OpenMP threads as available, so that no page fault
+ *                  is taken when it is first written.
+ * @return Pointer to the buffer, aligned to a cache line. It must be released
+ *         with huge_free().
+ *
+ * Buffers smaller than #HUGE_PAGE_SIZE are allocated from the heap. Larger
+ * ones are mapped as a whole number of huge pages: explicit ones
+ * (`MAP_HUGETLB`) if the system has reserved any, transparent ones
+ * (`MADV_HUGEPAGE`) otherwise. Huge pages take one TLB entry each instead of
+ * 512, which matters to the random increments of a wide count[].
+ */
+void *huge_alloc(long long size, bool prefault);
+
+/**
+ * @brief Release a buffer allocated by huge_alloc().
+ * @param ptr:  The buffer; nothing is done if `NULL`.
+ * @param size: Number of bytes it was allocated with.
+ */
+void huge_free(void *ptr, long long size);
+
+/**
+ * @brief Reserve a region of memory for the buffers of a run.
+ * @param arena:    The arena (output). It must be released with
+ *                  arena_destroy().
+ * @param size:     Number of bytes to reserve.
+ * @param prefault: Whether to touch every page of the region right away.
+ *
+ * The region is allocated by huge_alloc(), once: buffers taken from it add
+ * neither calls to the allocator nor, if pre-faulted, page faults.
+ */
+void arena_create(struct arena *arena, long long size, bool prefault);
+
+/**
+ * @brief Take a buffer from an arena.
+ * @param arena: The arena.
+ * @param size:  Number of bytes of the buffer.
+ * @return Pointer to the buffer, aligned to a cache line. It is released
+ *         together with the arena.
+ */
+void *arena_alloc(struct arena *arena, long long size);
+
+/**
+ * @brief Release an arena and all the buffers taken from it.
+ * @param arena: The arena.
+ */
+void arena_destroy(struct arena *arena);
+
+/**
+ * @brief Read the number of page faults taken by the calling process.
+ * @param faults: The page faults (output).
+ */
+void page_faults_read(struct page_faults *faults);
+
+
+#endif /* ARENA_H */
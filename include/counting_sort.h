@@ -28,6 +28,167 @@
 #ifndef COUNTING_SORT_H
 #define COUNTING_SORT_H
 
+#include <mpi.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "histogram.h"
+#include "node_array.h"
+#include "topology.h"
+
+
+/** @brief How the sorted array is rebuilt in every process. */
+enum expand_mode {
+    /**
+     * Each process writes its own portion of the sorted array; the portions are
+     * then collected by every process. Computation is O(n/P) per process,
+     * communication is O(n).
+     */
+    EXPAND_GATHER,
+    /**
+     * Only the global histogram is shared; each process writes the whole
+     * sorted array by itself. Computation is O(n) per process, communication is
+     * O(k).
+     */
+    EXPAND_LOCAL
+};
+
+
+/** @brief Algorithm used to sort the array. */
+enum sort_engine {
+    /**
+     * Choose the algorithm with the lowest estimated cost, judging from a
+     * sample of the array.
+     */
+    ENGINE_AUTO,
+    /** Counting Sort with one counter for every value in the range. */
+    ENGINE_DENSE,
+    /**
+     * Counting Sort with only the values that occur, counted in a hash table.
+     * Its memory and communication depend on the number of distinct values,
+     * not on the range.
+     */
+    ENGINE_SPARSE,
+    /**
+     * LSD Radix Sort: one Counting Sort pass for each digit of the values, so
+     * the memory of the count[] array is bounded for any range.
+     */
+    ENGINE_RADIX,
+    /**
+     * Sample Sort: every process sorts its portion and sends each element to
+     * the process of its bucket, among buckets split by sampled values. It
+     * only compares the values, so it suits any range and number of distinct
+     * values.
+     */
+    ENGINE_SAMPLE,
+    /**
+     * Comparison sort of the whole array, collected by every process. It does
+     * not depend on the values at all, but only suits small arrays.
+     */
+    ENGINE_COMPARISON
+};
+
+/** @brief Number of values of #sort_engine. */
+#define NUM_ENGINES (ENGINE_COMPARISON + 1)
+
+
+/** @brief Algorithm chosen to sort an array, with the figures behind it. */
+struct sort_decision {
+    /** Algorithm chosen. */
+    enum sort_engine engine;
+    /**
+     * Number of elements sampled from the whole array; 0 if the algorithm was
+     * given by the options, in which case none of the figures below is set.
+     */
+    long long sample_size;
+    /** Number of values in the range [min; max] of the array. */
+    long long range;
+    /** Estimated number of distinct values in the array. */
+    long long distinct;
+    /** Largest fraction of the sample holding the same value. */
+    double skew;
+    /** Fraction of the sampled pairs of adjacent elements already in order. */
+    double sortedness;
+    /**
+     * Estimated cost of each algorithm, indexed by #sort_engine, in units of
+     * the time needed to count one element; `HUGE_VAL` if it can not be used.
+     */
+    double cost[NUM_ENGINES];
+};
+
+
+/** @brief Options tuning the behaviour of the sorting algorithm. */
+struct sort_options {
+    /**
+     * How the sorted array is rebuilt in every process. Ignored by
+     * #ENGINE_RADIX and #ENGINE_SAMPLE, which always gather the sorted
+     * portions.
+     */
+    enum expand_mode expand;
+    /** Algorithm used to sort the array. */
+    enum sort_engine engine;
+    /** Number of bits in each digit of #ENGINE_RADIX (1 to 16). */
+    int radix_bits;
+    /** Kernel counting the elements of each portion with the dense count[]. */
+    enum histogram_kernel kernel;
+    /**
+     * Count the elements while finding the range of the values, reading the
+     * array once instead of twice. Only the dense engine can use it: if the
+     * range turns out too wide for it, the array is read again.
+     */
+    bool single_pass;
+    /**
+     * All values are known to lie in [range_min; range_max], so the range is
+     * not searched. The fixed ranges [0; 255], [0; 65535] and
+     * [#RANGE_MIN; #RANGE_MAX] are counted and expanded by specialised code.
+     */
+    bool range_known;
+    /** Lowest value allowed when `range_known` is set. */
+    int range_min;
+    /** Highest value allowed when `range_known` is set. */
+    int range_max;
+    /**
+     * If greater than 1, the dense count[] of each portion is built in this
+     * many chunks, reducing the counts of each chunk while the next one is
+     * counted; otherwise the whole portion is counted before reducing.
+     */
+    int pipeline_chunks;
+    /**
+     * Count and merge the dense count[] arrays one segment of the range at a
+     * time, so that each process keeps the counts of one segment only, then
+     * sends them to the processes owning their positions. `expand`,
+     * `pipeline_chunks` and `topology` are ignored, and so is this option when
+     * `single_pass` has already counted the whole range.
+     */
+    bool segmented;
+    /**
+     * Arrays of up to this many elements are counted, and their count[]
+     * merged, with 32-bit counters; longer ones with 64-bit counters, by the
+     * dense engine, counting this many elements at a time. Longer arrays can
+     * also be sorted by the radix and sample engines, but not by the sparse
+     * and comparison ones. At most INT_MAX, which is the default.
+     */
+    long long narrow_limit;
+    /**
+     * Processes grouped by node, to merge the histograms within each node
+     * before merging them among nodes; `NULL` to merge them among all
+     * processes at once. Pipelined counting and the sparse and radix engines
+     * always merge among all processes.
+     */
+    const struct topology *topology;
+    /**
+     * Where to store the algorithm chosen for the array and the figures behind
+     * it; `NULL` if not needed.
+     */
+    struct sort_decision *decision;
+};
+
+
+/**
+ * @brief Fill the given options with their default values.
+ * @param opts: The options.
+ */
+void sort_options_init(struct sort_options *opts);
 
 /**
  * @brief Sort the given array using Counting Sort Algorithm.
@@ -35,8 +196,193 @@
  * @param size:     Number of elements stored in the array.
  * @param num_proc: Number of MPI processes.
  * @param rank:     Rank of the process calling the function.
+ *
+ * Same as calling counting_sort_opts() with the default options.
  */
 void counting_sort(int *array, long long size, int num_proc, int rank);
 
+/**
+ * @brief Sort the given array using Counting Sort Algorithm.
+ * @param array:    The input array.
+ * @param size:     Number of elements stored in the array.
+ * @param opts:     Options tuning the algorithm.
+ * @param num_proc: Number of MPI processes.
+ * @param rank:     Rank of the process calling the function.
+ */
+void counting_sort_opts(int *array, long long size,
+                        const struct sort_options *opts, int num_proc,
+                        int rank);
+
+
+/**
+ * @brief Sort a distributed array using Counting Sort Algorithm.
+ * @param local_array: Portion of the array owned by the calling process.
+ * @param local_size:  Number of elements in the portion; it can differ among
+ *                     processes.
+ * @param opts:        Options tuning the algorithm.
+ * @param num_proc:    Number of MPI processes.
+ * @param rank:        Rank of the process calling the function.
+ *
+ * The array is made of the portions of all processes, laid out in rank order.
+ * No process ever holds more than its own portion, except with
+ * #ENGINE_COMPARISON, which the planner only chooses for small arrays: once
+ * sorted, each portion keeps its size and contains the elements of the sorted
+ * array that fall in its positions.
+ */
+void counting_sort_dist(int *local_array, long long local_size,
+                        const struct sort_options *opts, int num_proc,
+                        int rank);
+
+/**
+ * @brief Sort an array shared by the processes of each node using Counting Sort
+ *        Algorithm.
+ * @param array:    The array; each process has written its own portion, given
+ *                  by array_block(), in its place.
+ * @param size:     Number of elements stored in the array.
+ * @param opts:     Options tuning the algorithm; `expand` is ignored, since
+ *                  every process writes its own portion of the sorted array in
+ *                  place.
+ * @param num_proc: Number of MPI processes.
+ * @param rank:     Rank of the process calling the function.
+ *
+ * Each process counts its portion directly from the memory of the node and
+ * writes its portion of the sorted array in place, so no copy is made among
+ * processes of the same node; the portions are then only exchanged among
+ * nodes. Once sorted, the whole array is in the memory of every node.
+ */
+void counting_sort_shared(struct node_array *array, long long size,
+                          const struct sort_options *opts, int num_proc,
+                          int rank);
+
+/**
+ * @brief Stably sort an array of keys, each with its own payload.
+ * @param keys:         The keys, stored in every process.
+ * @param payload:      Payloads of the keys, one after the other, stored in
+ *                      every process.
+ * @param payload_size: Number of bytes of each payload.
+ * @param size:         Number of keys.
+ * @param opts:         Options tuning the algorithm; only `radix_bits` and
+ *                      the known range are considered.
+ * @param num_proc:     Number of MPI processes.
+ * @param rank:         Rank of the process calling the function.
+ *
+ * Unlike counting_sort(), the elements are not rebuilt from the histogram but
+ * moved to their positions, so every payload follows its key and elements with
+ * equal keys keep their relative order. Keys spanning at most #RADIX_MAX_BITS
+ * bits are sorted in a single Counting Sort pass; wider ones digit by digit.
+ * The whole array can hold more than INT_MAX keys, but no portion can.
+ */
+void counting_sort_kv(int *keys, void *payload, size_t payload_size,
+                      long long size, const struct sort_options *opts,
+                      int num_proc, int rank);
+
+/**
+ * @brief Stably sort a distributed array of keys, each with its own payload.
+ * @param local_keys:    Keys of the portion owned by the calling process.
+ * @param local_payload: Payloads of the keys, one after the other.
+ * @param payload_size:  Number of bytes of each payload.
+ * @param local_size:    Number of elements in the portion; it can differ among
+ *                       processes.
+ * @param opts:          Options tuning the algorithm; only `radix_bits` and
+ *                       the known range are considered.
+ * @param num_proc:      Number of MPI processes.
+ * @param rank:          Rank of the process calling the function.
+ *
+ * Distributed version of counting_sort_kv(): see counting_sort_dist() for the
+ * layout of the array.
+ */
+void counting_sort_kv_dist(int *local_keys, void *local_payload,
+                           size_t payload_size, long long local_size,
+                           const struct sort_options *opts, int num_proc,
+                           int rank);
+
+/**
+ * @brief Plan to sort the same array many times, as long as its size and the
+ *        range of its values stay the same.
+ *
+ * Everything that does not depend on the values is done once, when the plan
+ * is created: the portions, the buffers of the histogram and of its prefix
+ * sum, and, with MPI 4 or the extension of Open MPI, persistent requests for
+ * the reduction of count[] and for the gathering of the sorted portions. Each
+ * execution then only counts, reduces, expands and gathers.
+ */
+struct sort_plan {
+    /** The array sorted by every execution, stored in every process. */
+    int *array;
+    /** Number of elements stored in the array. */
+    long long size;
+    /** Lowest value allowed in the array. */
+    int min;
+    /** Highest value allowed in the array. */
+    int max;
+    /** Number of values in [min; max], and of counters in count[]. */
+    int count_size;
+    /** Kernel counting the elements of each portion. */
+    enum histogram_kernel kernel;
+    /** Communicator of the processes sharing the plan. */
+    MPI_Comm comm;
+    /** Number of processes in the communicator. */
+    int num_proc;
+    /** Rank of the calling process in the communicator. */
+    int rank;
+    /** Position of the portion of the calling process. */
+    long long local_offset;
+    /** Number of elements in the portion of the calling process. */
+    long long local_size;
+    /** The count[] array, with one counter for each value in [min; max]. */
+    int *count;
+    /** Position where each value starts in the sorted array. */
+    long long *starts;
+    /** Number of elements in the portion of every process. */
+    int *portion_sizes;
+    /** Position of the portion of every process. */
+    int *portion_offsets;
+    /** Persistent reduction of count[]; `MPI_REQUEST_NULL` if unavailable. */
+    MPI_Request reduce_request;
+    /** Persistent gathering of portions; `MPI_REQUEST_NULL` if unavailable. */
+    MPI_Request gather_request;
+    /** Number of executions so far. */
+    long long executions;
+    /** Time taken by the last execution, in seconds. */
+    double last_time;
+    /** Time taken by all executions, in seconds. */
+    double total_time;
+};
+
+
+/**
+ * @brief Create a plan to sort an array many times with the dense count[].
+ * @param plan:  The plan (output). It must be released with sort_plan_free().
+ * @param array: The array every execution sorts, stored in every process.
+ * @param size:  Number of elements stored in the array, at most INT_MAX.
+ * @param min:   Lowest value allowed in the array.
+ * @param max:   Highest value allowed in the array; `max - min` must be lower
+ *               than INT_MAX.
+ * @param opts:  Options tuning the algorithm; only `kernel` is considered.
+ * @param comm:  Communicator of the processes sharing the plan; it is
+ *               duplicated, so it can be freed right after.
+ *
+ * All processes of the communicator have to create the plan together.
+ */
+void sort_plan_create(struct sort_plan *plan, int *array, long long size,
+                      int min, int max, const struct sort_options *opts,
+                      MPI_Comm comm);
+
+/**
+ * @brief Sort the array of a plan.
+ * @param plan: The plan.
+ * @return Time taken by this execution, in seconds.
+ *
+ * All processes of the plan have to execute it together, after filling the
+ * array with values in the range of the plan.
+ */
+double sort_plan_execute(struct sort_plan *plan);
+
+/**
+ * @brief Release the resources held by a plan, but not its array.
+ * @param plan: The plan.
+ */
+void sort_plan_free(struct sort_plan *plan);
+
 
 #endif /* COUNTING_SORT_H */
@@ -0,0 +1,97 @@
+/**
+ * @file fill.h
+ * @brief This file provides the kernel writing runs of equal values, which
+ *        rebuild the sorted array from its histogram.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef FILL_H
+#define FILL_H
+
+#include <stdbool.h>
+
+
+/**
+ * @brief Tell whether an output is large enough to be written with
+ *        non-temporal stores.
+ * @param size: Number of elements that are going to be written.
+ * @return `true` if the output does not fit in the last level cache, which
+ *         would only be filled with data not read again soon; `false`
+ *         otherwise.
+ */
+bool fill_streaming(long long size);
+
+/**
+ * @brief Write the same value in consecutive elements of an array.
+ * @param out:       Where to write the run.
+ * @param size:      Number of elements in the run.
+ * @param value:     The value.
+ * @param streaming: Whether the cache lines entirely covered by the run are
+ *                   written with non-temporal stores; in this case fill_end()
+ *                   has to be called once the whole output has been written.
+ *
+ * Runs long enough are written with vector stores of the broadcast value.
+ */
+void fill_run(int *out, long long size, int value, bool streaming);
+
+/**
+ * @brief Make the non-temporal stores of fill_run() visible to the other
+ *        threads and processes.
+ * @param streaming: Whether the runs have been written with streaming stores.
+ */
+void fill_end(bool streaming);
+
+/**
+ * @brief Choose how many threads should write an output.
+ * @param size: Number of elements in the output.
+ * @return Number of threads, at least 1; always 1 without OpenMP.
+ */
+int fill_threads(long long size);
+
+/**
+ * @brief Find the part of an output that the calling thread has to write,
+ *        when it is split evenly among the threads of the current team.
+ * @param first: First position (inclusive) of the output.
+ * @param last:  Last position (exclusive) of the output.
+ * @param begin: First position (inclusive) of the part (output).
+ * @param end:   Last position (exclusive) of the part (output).
+ */
+void fill_slice(long long first, long long last, long long *begin,
+                long long *end);
+
+/**
+ * @brief Find the run covering a position of an output made of consecutive
+ *        runs.
+ * @param starts:   Position where each run starts, with the end of the last
+ *                  run as last item (`num_runs + 1` items).
+ * @param num_runs: Number of runs.
+ * @param position: The position, in [starts[0]; starts[num_runs]).
+ * @return Index of the first run that ends after the position.
+ *
+ * Runs with no elements are skipped, since they end where they start.
+ */
+long long fill_find_run(const long long *starts, long long num_runs,
+                        long long position);
+
+
+#endif /* FILL_H */
@@ -0,0 +1,179 @@
+/**
+ * @file histogram.h
+ * @brief This file provides the kernels counting the occurrences of each value
+ *        in an array, which is the core of Counting Sort.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <stdbool.h>
+
+
+/** @brief Kernel used to count the occurrences of each value. */
+enum histogram_kernel {
+    /** Choose depending on the input and on the instructions available. */
+    KERNEL_AUTO,
+    /** One element at a time, in a single count[] array. */
+    KERNEL_SCALAR,
+    /**
+     * Specialised for a range known at compile time: [0; 255], [0; 65535] or
+     * [#RANGE_MIN; #RANGE_MAX]. Other ranges are counted by the scalar kernel.
+     */
+    KERNEL_FIXED,
+    /** Consecutive elements spread over 4 sub-histograms. */
+    KERNEL_INTERLEAVED,
+    /** AVX-512 gather/scatter, with VPCONFLICTD resolving equal values. */
+    KERNEL_AVX512,
+    /**
+     * Elements first partitioned by the high bits of their value, so that each
+     * group only updates a slice of count[] small enough for the L2 cache.
+     */
+    KERNEL_BLOCKED,
+    /** One element at a time, prefetching the counters of the next ones. */
+    KERNEL_PREFETCH
+};
+
+
+/**
+ * @brief Private count[] replicas of the OpenMP threads, kept across calls so
+ *        that an array counted a block at a time allocates, zeroes and sums
+ *        them only when its counts are needed.
+ */
+struct histogram_replicas {
+    /** Replicas of count[], one for each thread, one after the other. */
+    int *count;
+    /** Number of items in each replica. */
+    int count_size;
+    /** Number of replicas. */
+    int num_threads;
+    /** Minimum value counted. */
+    int min;
+    /** Kernel counting each block. */
+    enum histogram_kernel kernel;
+};
+
+
+/**
+ * @brief Tell whether a kernel can run on the current CPU.
+ * @param kernel: The kernel.
+ * @return `true` if the kernel is supported; `false` otherwise.
+ */
+bool histogram_kernel_supported(enum histogram_kernel kernel);
+
+/**
+ * @brief Count the occurrences of each value in the array.
+ * @param array:      The array.
+ * @param size:       Number of elements in the array.
+ * @param min:        Minimum value stored in the array.
+ * @param count:      Number of occurrences of each value (output).
+ * @param count_size: Number of items in count[], one for each value starting
+ *                    from `min`.
+ * @param kernel:     Kernel to count with; the scalar one is used if it is not
+ *                    supported by the CPU.
+ *
+ * When compiled with OpenMP, the array is split among the threads, each of
+ * which counts in a private replica of count[]; the replicas are then summed
+ * by all threads together, each one taking care of a slice of count[].
+ */
+void histogram_count(const int *array, long long size, int min, int *count,
+                     int count_size, enum histogram_kernel kernel);
+
+/**
+ * @brief Add the occurrences of each value in the array to count[].
+ * @param array:      The array.
+ * @param size:       Number of elements in the array.
+ * @param min:        Minimum value stored in the array.
+ * @param count:      Number of occurrences of each value (input/output).
+ * @param count_size: Number of items in count[].
+ * @param kernel:     Kernel to count with.
+ *
+ * Same as histogram_count(), without zeroing count[] first, so that an array
+ * can be counted a piece at a time.
+ */
+void histogram_add(const int *array, long long size, int min, int *count,
+                   int count_size, enum histogram_kernel kernel);
+
+/**
+ * @brief Allocate zeroed replicas of count[] for the OpenMP threads.
+ * @param replicas:   The replicas (output). They must be released with
+ *                    histogram_replicas_free().
+ * @param block_size: Number of elements of the blocks that will be counted,
+ *                    which sets the number of threads and the kernel.
+ * @param min:        Minimum value stored in the array.
+ * @param count_size: Number of items in count[].
+ * @param kernel:     Kernel to count with.
+ */
+void histogram_replicas_create(struct histogram_replicas *replicas,
+                               long long block_size, int min, int count_size,
+                               enum histogram_kernel kernel);
+
+/**
+ * @brief Count a block of the array in the replicas, each thread in its own.
+ * @param replicas: The replicas.
+ * @param array:    The block.
+ * @param size:     Number of elements in the block.
+ */
+void histogram_replicas_add(struct histogram_replicas *replicas,
+                            const int *array, long long size);
+
+/**
+ * @brief Add the replicas into count[] and zero them for the next blocks.
+ * @param replicas: The replicas.
+ * @param count:    Number of occurrences of each value (input/output).
+ */
+void histogram_replicas_flush(struct histogram_replicas *replicas, int *count);
+
+/**
+ * @brief Release the replicas of count[].
+ * @param replicas: The replicas.
+ */
+void histogram_replicas_free(struct histogram_replicas *replicas);
+
+/**
+ * @brief Count the occurrences of each value in the array while finding its
+ *        minimum and maximum value, reading the array only once.
+ * @param array:          The array.
+ * @param size:           Number of elements in the array.
+ * @param max_count_size: Maximum number of items in count[].
+ * @param min:            Minimum value stored in the array (output); INT_MAX
+ *                        if the array is empty.
+ * @param max:            Maximum value stored in the array (output); INT_MIN
+ *                        if the array is empty.
+ * @param count:          Number of occurrences of each value in [min; max]
+ *                        (output); `NULL` if the array is empty or the values
+ *                        were not counted. It must be freed by the caller.
+ * @return `false` if [min; max] holds more than `max_count_size` values, so
+ *         that only min and max have been found; `true` otherwise.
+ *
+ * count[] starts from the first values met and grows, on the side of any new
+ * extreme, as needed. Since the range is not known in advance, only the scalar
+ * kernel is used.
+ */
+bool histogram_count_range(const int *array, long long size,
+                           long long max_count_size, int *min, int *max,
+                           int **count);
+
+
+#endif /* HISTOGRAM_H */
@@ -0,0 +1,99 @@
+/**
+ * @file node_array.h
+ * @brief This file provides an array allocated once for each node, in memory
+ *        shared by all the MPI processes running on it.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef NODE_ARRAY_H
+#define NODE_ARRAY_H
+
+#include <mpi.h>
+
+#include "topology.h"
+
+
+/**
+ * @brief Array of integers shared by all processes of a node, each node holding
+ *        its own copy.
+ */
+struct node_array {
+    /** The elements, in memory shared by the processes of the node. */
+    int *data;
+    /** Window exposing the shared memory. */
+    MPI_Win win;
+    /** Processes grouped by the node they run on. */
+    struct topology topology;
+};
+
+
+/**
+ * @brief Allocate an array shared by the processes of each node.
+ * @param array:          The array (output). It must be released with
+ *                        node_array_free().
+ * @param size:           Number of elements in the array.
+ * @param ranks_per_node: If greater than 0, groups of this many consecutive
+ *                        processes are taken as nodes, as long as they can
+ *                        share memory; otherwise the actual nodes are used.
+ * @param num_proc:       Number of MPI processes.
+ * @param rank:           Rank of the process calling the function.
+ *
+ * Only the first process of each node allocates the memory; the others map the
+ * same memory, so the array takes the same space however many processes run
+ * on the node.
+ */
+void node_array_alloc(struct node_array *array, long long size,
+                      int ranks_per_node, int num_proc, int rank);
+
+/**
+ * @brief Release an array shared by the processes of each node.
+ * @param array: The array.
+ */
+void node_array_free(struct node_array *array);
+
+/**
+ * @brief Make the elements written by each process of a node visible to the
+ *        other processes of the same node.
+ * @param array: The array.
+ *
+ * It has to be called by all processes of the node.
+ */
+void node_array_sync(const struct node_array *array);
+
+/**
+ * @brief Copy the portion of every process into the array of every node.
+ * @param array:    The array, where each process has written its own portion
+ *                  in its place.
+ * @param size:     Number of elements in the array.
+ * @param num_proc: Number of MPI processes.
+ *
+ * The portions are those given by array_block(). Portions written by processes
+ * of the same node are already in place: only the first process of each node
+ * sends the portions of its node to the other nodes, split in chunks of at
+ * most #LARGE_COUNT_CHUNK elements.
+ */
+void node_array_gather(struct node_array *array, long long size,
+                       int num_proc);
+
+
+#endif /* NODE_ARRAY_H */
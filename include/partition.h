@@ -0,0 +1,125 @@
+/**
+ * @file partition.h
+ * @brief This file provides the partitioning of arrays among the MPI
+ *        processes, shared by the initialization and sorting functions.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef PARTITION_H
+#define PARTITION_H
+
+#include <limits.h>
+#include <mpi.h>
+
+
+/**
+ * @brief Largest number of elements moved by a single MPI call, whose counts
+ *        are `int`: longer arrays are moved in chunks of this many elements.
+ */
+#ifndef LARGE_COUNT_CHUNK
+#define LARGE_COUNT_CHUNK INT_MAX
+#endif
+
+
+/**
+ * @brief Compute the portion of an array owned by a process.
+ * @param size:       Number of elements in the whole array.
+ * @param num_proc:   Number of MPI processes.
+ * @param rank:       Rank of the process owning the portion.
+ * @param offset:     Position of the first element of the portion (output).
+ * @param local_size: Number of elements in the portion (output).
+ *
+ * The portions follow each other in rank order. Without weights, their sizes
+ * differ by at most one element; with the weights set by
+ * partition_set_weights(), each portion is proportional to the weight of its
+ * process.
+ */
+void array_block(long long size, int num_proc, int rank, long long *offset,
+                 long long *local_size);
+
+/**
+ * @brief Collect the portions of all processes into the array of every
+ *        process.
+ * @param array:    The array, holding the portion of the calling process, given
+ *                  by array_block(), in its place.
+ * @param type:     Type of the elements of the array.
+ * @param size:     Number of elements stored in the array.
+ * @param num_proc: Number of MPI processes.
+ *
+ * Arrays of more than #LARGE_COUNT_CHUNK elements are collected by the
+ * large-count MPI_Allgatherv_c() of MPI 4 or, before it, broadcast by each
+ * process in chunks.
+ */
+void array_gather(void *array, MPI_Datatype type, long long size,
+                  int num_proc);
+
+/**
+ * @brief Send a block of elements to every process and receive one from every
+ *        process, with counts and positions that need not fit in an `int`.
+ * @param send:        Elements to send.
+ * @param send_counts: Number of elements sent to each process.
+ * @param send_displs: Position in `send` of the elements sent to each process.
+ * @param recv:        Where to store the elements received (output).
+ * @param recv_counts: Number of elements received from each process.
+ * @param recv_displs: Position in `recv` of the elements received from each
+ *                     process.
+ * @param type:        Type of the elements.
+ * @param num_proc:    Number of MPI processes.
+ *
+ * Same as MPI_Alltoallv() over MPI_COMM_WORLD, which is called when every
+ * count and position of every process fits in an `int`. Otherwise, the
+ * large-count MPI_Alltoallv_c() of MPI 4 is called or, before it, each block
+ * is sent point to point in chunks of #LARGE_COUNT_CHUNK elements.
+ */
+void array_alltoallv(const void *send, const long long *send_counts,
+                     const long long *send_displs, void *recv,
+                     const long long *recv_counts,
+                     const long long *recv_displs, MPI_Datatype type,
+                     int num_proc);
+
+/**
+ * @brief Set the relative speed of every process, which the portions of all
+ *        arrays are made proportional to.
+ * @param weights:  Weight of every process, greater than 0; `NULL` to give all
+ *                  processes the same portion.
+ * @param num_proc: Number of MPI processes.
+ *
+ * Every process has to set the same weights before partitioning any array,
+ * since each one computes the portions of all the others.
+ */
+void partition_set_weights(const double *weights, int num_proc);
+
+/**
+ * @brief Measure how fast every process counts and set the weights of the
+ *        processes accordingly.
+ * @param num_proc: Number of MPI processes.
+ * @param rank:     Rank of the process calling the function.
+ *
+ * Every process times the counting of the same number of elements, with as
+ * many threads as it would use to sort; the weights, inversely proportional
+ * to those times, are then shared with all processes.
+ */
+void partition_measure_weights(int num_proc, int rank);
+
+
+#endif /* PARTITION_H */
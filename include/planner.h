@@ -0,0 +1,73 @@
+/**
+ * @file planner.h
+ * @brief This file provides the planner choosing the algorithm to sort an
+ *        array with, from a sample of its elements.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include <stdbool.h>
+
+#include "counting_sort.h"
+
+
+/**
+ * @brief Choose the algorithm to sort a distributed array with.
+ * @param local_array: Portion of the array owned by the calling process.
+ * @param local_size:  Number of elements in the portion.
+ * @param size:        Number of elements in the whole array.
+ * @param min:         Minimum value stored in the whole array.
+ * @param max:         Maximum value stored in the whole array.
+ * @param engine:      Algorithm requested; the array is only sampled for
+ *                     #ENGINE_AUTO, otherwise it is chosen as it is.
+ * @param radix_bits:  Number of bits in each digit of #ENGINE_RADIX.
+ * @param replicated:  Whether every process ends up with the whole sorted
+ *                     array, which has to be collected after the algorithms
+ *                     sorting by portions.
+ * @param num_proc:    Number of MPI processes.
+ * @param decision:    Algorithm chosen, with the figures behind it (output).
+ *
+ * Every process samples evenly spaced elements of its portion, also checking
+ * whether each one is in order with the next; the samples are then collected
+ * by all processes, which take the same decision. The number of distinct
+ * values is estimated from the values met once and more than once in the
+ * sample, and the cost of each algorithm from the size of the portions, the
+ * range, the distinct values and the number of messages it exchanges.
+ */
+void plan_engine(const int *local_array, long long local_size, long long size,
+                 int min, int max, enum sort_engine engine, int radix_bits,
+                 bool replicated, int num_proc,
+                 struct sort_decision *decision);
+
+/**
+ * @brief Get the name of an algorithm.
+ * @param engine: The algorithm.
+ * @return Name of the algorithm, as given to the options of the program.
+ */
+const char *sort_engine_name(enum sort_engine engine);
+
+
+#endif /* PLANNER_H */
@@ -0,0 +1,123 @@
+/**
+ * @file radix_sort.h
+ * @brief This file provides the functions needed to sort a distributed array of
+ *        integers with an LSD Radix Sort, made of one Counting Sort pass for
+ *        each digit of the values.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef RADIX_SORT_H
+#define RADIX_SORT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/** @brief Maximum number of bits in a digit. */
+#define RADIX_MAX_BITS 16
+
+
+/**
+ * @brief Portion of a distributed array of keys owned by a process, with the
+ *        payloads that have to follow them, if any.
+ */
+struct radix_portion {
+    /** Keys of the portion. */
+    unsigned *keys;
+    /** Buffer as big as the keys. */
+    unsigned *keys_tmp;
+    /** Payloads of the keys, one after the other; `NULL` if there are none. */
+    char *payload;
+    /** Buffer as big as the payloads. */
+    char *payload_tmp;
+    /** Number of bytes of each payload. */
+    size_t payload_size;
+    /** Number of elements in the portion. */
+    long long size;
+    /**
+     * Position of the portion of every process in the whole array, plus the
+     * size of the whole array as last item.
+     */
+    const long long *offsets;
+};
+
+
+/**
+ * @brief Stably sort a distributed array of keys by one of their digits.
+ * @param portion:  Portion of the array owned by the calling process
+ *                  (input/output); its buffers are swapped when elements move.
+ * @param shift:    Position of the lowest bit of the digit.
+ * @param bits:     Number of bits of the digit.
+ * @param num_proc: Number of MPI processes.
+ * @param rank:     Rank of the process calling the function.
+ * @return `false` if the digit is the same for all elements and nothing has
+ *         been moved; `true` otherwise.
+ *
+ * Each process counts the digits in its portion and scatters its elements by
+ * digit; the position of every element in the whole array follows from the
+ * global count of each digit and from the count of the same digit in the
+ * processes with lower rank. The elements are then sent to the processes
+ * owning those positions, which scatter what they receive by digit once more.
+ */
+bool radix_pass(struct radix_portion *portion, int shift, int bits,
+                int num_proc, int rank);
+
+/**
+ * @brief Sort a distributed array using LSD Radix Sort.
+ * @param local_array: Portion of the array owned by the calling process.
+ * @param local_size:  Number of elements in the portion.
+ * @param min:         Minimum value stored in the whole array.
+ * @param max:         Maximum value stored in the whole array.
+ * @param bits:        Number of bits in each digit, at most #RADIX_MAX_BITS.
+ * @param num_proc:    Number of MPI processes.
+ * @param rank:        Rank of the process calling the function.
+ *
+ * The values are sorted by their distance from `min`, so only the digits
+ * needed to represent `max - min` are considered. Once sorted, each portion
+ * keeps its size and contains the elements of the sorted array that fall in
+ * its positions.
+ */
+void radix_sort_dist(int *local_array, long long local_size, int min, int max,
+                     int bits, int num_proc, int rank);
+
+/**
+ * @brief Stably sort a distributed array of keys, each with its own payload,
+ *        using LSD Radix Sort.
+ * @param local_keys:    Keys of the portion owned by the calling process.
+ * @param local_payload: Payloads of the keys, one after the other.
+ * @param payload_size:  Number of bytes of each payload.
+ * @param local_size:    Number of elements in the portion.
+ * @param min:           Minimum key in the whole array.
+ * @param max:           Maximum key in the whole array.
+ * @param bits:          Number of bits in each digit, at most #RADIX_MAX_BITS.
+ * @param num_proc:      Number of MPI processes.
+ * @param rank:          Rank of the process calling the function.
+ *
+ * Same as radix_sort_dist(), but every payload is moved together with its key
+ * and elements with equal keys keep their relative order.
+ */
+void radix_sort_kv_dist(int *local_keys, void *local_payload,
+                        size_t payload_size, long long local_size, int min,
+                        int max, int bits, int num_proc, int rank);
+
+
+#endif /* RADIX_SORT_H */
@@ -0,0 +1,58 @@
+/**
+ * @file sample_sort.h
+ * @brief This file provides a distributed Sample Sort, for arrays whose range
+ *        is too wide to be counted.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SAMPLE_SORT_H
+#define SAMPLE_SORT_H
+
+
+/**
+ * @brief Sort a distributed array using Sample Sort.
+ * @param local_array: Portion of the array owned by the calling process.
+ * @param local_size:  Number of elements in the portion.
+ * @param num_proc:    Number of MPI processes.
+ * @param rank:        Rank of the process calling the function.
+ *
+ * Every process sorts its portion and picks regularly spaced samples from it;
+ * out of all the samples, `num_proc - 1` splitters divide the values into as
+ * many buckets as processes. Each element is sent to the process of its
+ * bucket, which merges the sorted runs it receives; the buckets are then
+ * moved to the positions of the portions, so that once sorted each portion
+ * keeps its size and contains the elements of the sorted array that fall in
+ * its positions.
+ *
+ * Only comparisons are made, so neither the range nor the number of distinct
+ * values matter. Equal elements are told apart by their position in the whole
+ * array, so that no bucket gets more than about twice its share of elements,
+ * however many duplicates there are. Portions and buckets may hold more than
+ * `INT_MAX` elements: they are exchanged with array_alltoallv().
+ */
+void sample_sort_dist(int *local_array, long long local_size, int num_proc,
+                      int rank);
+
+
+#endif /* SAMPLE_SORT_H */
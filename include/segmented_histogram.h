@@ -0,0 +1,68 @@
+/**
+ * @file segmented_histogram.h
+ * @brief This file provides the reduction of the histograms of all processes
+ *        into segments of the range, each one owned by a single process.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef SEGMENTED_HISTOGRAM_H
+#define SEGMENTED_HISTOGRAM_H
+
+#include "histogram.h"
+#include "sparse_histogram.h"
+
+
+/**
+ * @brief Count the occurrences of each value in a distributed array, keeping
+ *        only the counts falling in the positions of the calling process.
+ * @param local_array: Portion of the array owned by the calling process.
+ * @param local_size:  Number of elements in the portion.
+ * @param min:         Minimum value stored in the whole array.
+ * @param max:         Maximum value stored in the whole array.
+ * @param offsets:     Position of the portion of every process in the whole
+ *                     array, plus the size of the whole array as last item.
+ * @param kernel:      Kernel counting the elements of the portion.
+ * @param num_proc:    Number of MPI processes.
+ * @param rank:        Rank of the process calling the function.
+ * @param num_runs:    Number of runs returned (output).
+ * @return Runs of the sorted array, by value, covering exactly the positions
+ *         of the portion of the calling process. They must be freed by the
+ *         caller.
+ *
+ * The range [min; max] is split into `num_proc` segments of the same length,
+ * and the portion is grouped by segment. Segment after segment, the elements
+ * of the portion falling in it are counted and the counts reduced into the
+ * process owning the segment, while the next segment is counted: local and
+ * merged counts take k / P memory in each process, instead of k, and each
+ * process makes k / P additions. Each process then sends the values of its
+ * segment, with their counts, to the processes owning their positions in the
+ * sorted array.
+ */
+struct run *segmented_count(const int *local_array, long long local_size,
+                            int min, int max, const long long *offsets,
+                            enum histogram_kernel kernel, int num_proc,
+                            int rank, long long *num_runs);
+
+
+#endif /* SEGMENTED_HISTOGRAM_H */
@@ -0,0 +1,101 @@
+/**
+ * @file sparse_histogram.h
+ * @brief This file provides the functions needed to count the occurrences of
+ *        the values in an array when they are sparse in a wide range, without
+ *        allocating one counter for each value of the range.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPARSE_HISTOGRAM_H
+#define SPARSE_HISTOGRAM_H
+
+#include <mpi.h>
+
+
+/**
+ * @brief A value stored in the array together with its number of occurrences.
+ *
+ * A sparse histogram is an array of runs sorted by value, holding only the
+ * values that occur at least once.
+ */
+struct run {
+    /** A value stored in the array. */
+    int value;
+    /** Number of times the value occurs; never 0 in a histogram. */
+    int count;
+};
+
+
+/**
+ * @brief Create the MPI datatype of a run.
+ * @param type: The datatype, committed; it must be freed with MPI_Type_free()
+ *              (output).
+ */
+void sparse_run_type(MPI_Datatype *type);
+
+
+/**
+ * @brief Count the occurrences of every distinct value in the array.
+ * @param array:    The array.
+ * @param size:     Number of elements in the array.
+ * @param num_runs: Number of distinct values found (output).
+ * @return The runs, sorted by value. They must be freed by the caller.
+ *
+ * The values are counted in an open-addressing hash table whose size depends
+ * on the number of elements and not on the range of their values.
+ */
+struct run *sparse_count(const int *array, long long size, long long *num_runs);
+
+/**
+ * @brief Merge the sparse histograms of all processes.
+ * @param runs:     Sorted runs of the calling process; they are freed.
+ * @param num_runs: Number of runs of the calling process; it is replaced by the
+ *                  number of runs in the merged histogram (input/output).
+ * @param num_proc: Number of MPI processes.
+ * @param rank:     Rank of the process calling the function.
+ * @return The merged runs, shared with all processes. They must be freed by the
+ *         caller.
+ *
+ * The histograms are merged along a binomial tree rooted in process 0, so the
+ * reduction has logarithmic depth; the result is then broadcast.
+ */
+struct run *sparse_reduce(struct run *runs, long long *num_runs, int num_proc,
+                          int rank);
+
+/**
+ * @brief Write the elements of the sorted array that fall in the positions
+ *        [first; last), according to a sparse histogram.
+ * @param out:      Where to write the elements; `out[0]` is position `first`.
+ * @param runs:     Runs of the whole array, sorted by value.
+ * @param num_runs: Number of runs.
+ * @param first:    First position (inclusive) of the sorted array to write.
+ * @param last:     Last position (exclusive) of the sorted array to write.
+ *
+ * When compiled with OpenMP, the positions are split evenly among the threads;
+ * each one finds the run its part starts in by binary search.
+ */
+void sparse_expand(int *out, const struct run *runs, long long num_runs,
+                   long long first, long long last);
+
+
+#endif /* SPARSE_HISTOGRAM_H */
@@ -0,0 +1,95 @@
+/**
+ * @file topology.h
+ * @brief This file provides the grouping of MPI processes by node, used to
+ *        communicate within each node before communicating among nodes.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <mpi.h>
+
+
+/**
+ * @brief Value of `ranks_per_node` grouping the processes by NUMA domain
+ *        instead of by node.
+ */
+#define TOPOLOGY_NUMA -1
+
+
+/** @brief MPI processes grouped by the node they run on. */
+struct topology {
+    /** Processes of the same node. */
+    MPI_Comm node_comm;
+    /** First process of each node; `MPI_COMM_NULL` in the other processes. */
+    MPI_Comm leader_comm;
+    /** Number of nodes. */
+    int num_nodes;
+    /** Number of processes on the node of the calling process. */
+    int node_size;
+    /** Index of the node of every process, in the order of their leaders. */
+    int *node_of;
+};
+
+
+/**
+ * @brief Group the MPI processes by node.
+ * @param topo:           The topology (output). It must be released with
+ *                        topology_free().
+ * @param ranks_per_node: If greater than 0, groups of this many consecutive
+ *                        processes are taken as nodes, as long as they can
+ *                        share memory; with #TOPOLOGY_NUMA, the processes of
+ *                        each NUMA domain are; otherwise the actual nodes are
+ *                        used.
+ * @param num_proc:       Number of MPI processes.
+ * @param rank:           Rank of the process calling the function.
+ */
+void topology_create(struct topology *topo, int ranks_per_node, int num_proc,
+                     int rank);
+
+/**
+ * @brief Release the communicators of a topology.
+ * @param topo: The topology.
+ */
+void topology_free(struct topology *topo);
+
+/**
+ * @brief Combine the values of all processes and share the result with all of
+ *        them, in place.
+ * @param buffer: The values of the calling process, replaced by the result.
+ * @param count:  Number of values.
+ * @param type:   Type of the values.
+ * @param op:     Operation combining the values.
+ * @param topo:   Topology of the processes; `NULL` to combine them all at once.
+ *
+ * The values are first reduced within each node, then among one leader for
+ * each node, and the result is broadcast within each node: only one process
+ * for each node communicates with the other nodes. When all processes run on
+ * a single node, or each on its own node, this is a plain MPI_Allreduce.
+ */
+void topology_allreduce(void *buffer, int count, MPI_Datatype type, MPI_Op op,
+                        const struct topology *topo);
+
+
+#endif /* TOPOLOGY_H */
@@ -89,6 +89,9 @@ void *safe_alloc(long long size);
  * @param max:      Maximum value accepted in the array.
  * @param num_proc: Number of MPI processes.
  * @param rank:     Rank of the process calling the function.
+ *
+ * Each process generates the portion given by array_block(); the portions are
+ * then collected by every process.
  */
 void array_init_random(int *array, long long size, int min, int max,
                        int num_proc, int rank);
@@ -100,10 +103,36 @@ void array_init_random(int *array, long long size, int min, int max,
  * @param file_path: Path to the file containing the numbers.
  * @param num_proc:  Number of MPI processes.
  * @param rank:      Rank of the process calling the function.
+ *
+ * Each process reads the portion given by array_block(); the portions are
+ * then collected by every process.
  */
 void array_init_from_file(int *array, long long size, const char *file_path,
                           int num_proc, int rank);
 
+/**
+ * @brief Fill the portion of a distributed array owned by the calling process
+ *        with random integers.
+ * @param local_array: The portion of the array.
+ * @param local_size:  Number of elements to generate.
+ * @param min:         Minimum value accepted in the array.
+ * @param max:         Maximum value accepted in the array.
+ * @param rank:        Rank of the process calling the function.
+ */
+void array_init_random_local(int *local_array, long long local_size, int min,
+                             int max, int rank);
+
+/**
+ * @brief Fill the portion of a distributed array owned by the calling process
+ *        with integers read from a file.
+ * @param local_array: The portion of the array.
+ * @param local_size:  Number of elements to read from the file.
+ * @param offset:      Position of the portion in the whole array.
+ * @param file_path:   Path to the file containing the numbers.
+ */
+void array_init_from_file_local(int *local_array, long long local_size,
+                                long long offset, const char *file_path);
+
 /**
  * @brief Find min and max values in the array.
  * @param array: The array.
@@ -113,5 +142,14 @@ void array_init_from_file(int *array, long long size, const char *file_path,
  */
 void array_min_max(const int *array, long long size, int *min, int *max);
 
+/**
+ * @brief Compare two integers, to be used with `qsort()`.
+ * @param a: First integer.
+ * @param b: Second integer.
+ * @return Negative, zero or positive if the first integer is lesser, equal or
+ *         greater than the second one.
+ */
+int compare_ints(const void *a, const void *b);
+
 
 #endif /* UTIL_H */
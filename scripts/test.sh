@@ -44,6 +44,10 @@ OPTIONS
     --silent
         Suppress all test output except failure messages.
 
+    --large-count
+        Compile moving at most 1000 elements with each MPI call, to test on
+        small arrays the chunked transfers of arrays longer than 2^31 elements.
+
     -n N, --numproc N
         Use N processes in parallel execution. (default is 4)" | more -d
 }
@@ -81,6 +85,9 @@ while [[ -n $1 ]]; do
         --silent)
             out_stream="/dev/null"
             shift ;;
+        --large-count)
+            make_target="test-large"
+            shift ;;
         -n | --numproc)
             num_proc=$2
             [[ -z $num_proc ]] && raise_error "No number of processes given."
@@ -99,6 +106,7 @@ fi
 # Default values.
 num_proc=${num_proc:="4"}
 out_stream=${out_stream:="/dev/stdout"}
+make_target=${make_target:="test"}
 
 # Determine root project directory based on whether this script has been
 # launched from there or from the scripts/ subdirectory.
@@ -112,7 +120,7 @@ executable_file="$project_dir/bin/test.out"
 make -C "$project_dir" clean > /dev/null 2>&1
 
 # Compile.
-make -C "$project_dir" test > /dev/null
+make -C "$project_dir" $make_target > /dev/null
 [[ $? != 0 ]] && raise_error
 
 # Generate a file containing enough random integers to test the program with.
@@ -0,0 +1,168 @@
+/**
+ * @file affinity.c
+ * @brief This file contains the placement of threads and pages on the NUMA
+ *        nodes: CPU pinning, first touch and a report of local pages.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+/* Needed for the CPU sets of sched_setaffinity(). */
+#define _GNU_SOURCE
+
+#include "affinity.h"
+
+#include <mpi.h>
+#include <sched.h>
+#include <stdint.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+
+/**
+ * @brief Find the slice of a range of items taken by the calling OpenMP
+ *        thread, the same way the counting kernels split an array.
+ * @param size:  Number of items in the range.
+ * @param first: First item of the slice (output).
+ * @param last:  Item after the last one of the slice (output).
+ */
+static void thread_slice(long long size, long long *first, long long *last) {
+#ifdef _OPENMP
+    const int thread = omp_get_thread_num();
+    const int num_threads = omp_get_num_threads();
+#else
+    const int thread = 0;
+    const int num_threads = 1;
+#endif
+    *first = size * thread / num_threads;
+    *last = size * (thread + 1) / num_threads;
+}
+
+
+
+bool affinity_pin(int rank) {
+    MPI_Comm node_comm;
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank,
+                        MPI_INFO_NULL, &node_comm);
+    int node_rank;
+    MPI_Comm_rank(node_comm, &node_rank);
+    MPI_Comm_free(&node_comm);
+
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return false;
+    int cpus[CPU_SETSIZE];
+    int num_cpus = 0;
+    for (int c = 0; c < CPU_SETSIZE; c++)
+        if (CPU_ISSET(c, &allowed))
+            cpus[num_cpus++] = c;
+
+#ifdef _OPENMP
+    const int num_threads = omp_get_max_threads();
+#else
+    const int num_threads = 1;
+#endif
+    int failed = 0;
+
+    /* The threads of a team are kept for the following parallel regions. */
+    #pragma omp parallel num_threads(num_threads) reduction(+: failed)
+    {
+#ifdef _OPENMP
+        const int thread = omp_get_thread_num();
+#else
+        const int thread = 0;
+#endif
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpus[((long long)node_rank * num_threads + thread) % num_cpus],
+                &set);
+        failed += sched_setaffinity(0, sizeof(set), &set) != 0;
+    }
+    return failed == 0;
+}
+
+
+void first_touch(void *buffer, long long size) {
+    const long long page = sysconf(_SC_PAGESIZE);
+    volatile char *bytes = (volatile char *)buffer;
+
+    #pragma omp parallel
+    {
+        long long first = 0, last = 0;
+        thread_slice(size, &first, &last);
+        /* A byte of each page the slice starts or goes through. */
+        for (long long i = first; i < last; i = (i / page + 1) * page)
+            bytes[i] = 0;
+    }
+}
+
+
+void numa_balance_measure(const void *buffer, long long size,
+                          struct numa_balance *balance)
+{
+    const long long page = sysconf(_SC_PAGESIZE);
+    long long local = 0, remote = 0, unknown = 0;
+
+    #pragma omp parallel reduction(+: local, remote, unknown)
+    {
+        long long first = 0, last = 0;
+        thread_slice(size, &first, &last);
+
+        /* Pages evenly spread across the slice. */
+        void *pages[NUMA_SAMPLE_PAGES];
+        int status[NUMA_SAMPLE_PAGES];
+        const long long num_pages = (last - first + page - 1) / page;
+        const long long step = num_pages > NUMA_SAMPLE_PAGES
+                               ? (num_pages + NUMA_SAMPLE_PAGES - 1) /
+                                 NUMA_SAMPLE_PAGES
+                               : 1;
+        const uintptr_t start = (uintptr_t)buffer + first;
+        int num_samples = 0;
+        for (long long p = 0; p < num_pages; p += step)
+            pages[num_samples++] = (void *)((start + p * page) &
+                                            ~(uintptr_t)(page - 1));
+
+        /* Without target nodes, move_pages only tells where pages are. */
+        unsigned cpu = 0, node = 0;
+        bool found = num_samples > 0 &&
+                     syscall(SYS_getcpu, &cpu, &node, NULL) == 0 &&
+                     syscall(SYS_move_pages, 0, num_samples, pages, NULL,
+                             status, 0) == 0;
+        if (!found)
+            unknown += num_samples;
+        for (int i = 0; found && i < num_samples; i++) {
+            if (status[i] < 0)
+                unknown++;
+            else if ((unsigned)status[i] == node)
+                local++;
+            else
+                remote++;
+        }
+    }
+
+    balance->local = local;
+    balance->remote = remote;
+    balance->unknown = unknown;
+}
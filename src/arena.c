@@ -0,0 +1,166 @@
+/**
+ * @file arena.c
+ * @brief This file contains the allocation of large buffers, backed by huge
+ *        pages and optionally pre-faulted, and the counting of page faults.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "arena.h"
+
+#include <mpi.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+
+/**
+ * @brief Round a number of bytes up to a whole number of huge pages.
+ * @param size: Number of bytes.
+ * @return The rounded number of bytes.
+ */
+static long long huge_size(long long size) {
+    return (size + HUGE_PAGE_SIZE - 1) / HUGE_PAGE_SIZE * HUGE_PAGE_SIZE;
+}
+
+
+/**
+ * @brief Map memory aligned to a huge page, to be backed by transparent huge
+ *        pages.
+ * @param size: Number of bytes to map, a multiple of #HUGE_PAGE_SIZE.
+ * @return Pointer to the memory; `MAP_FAILED` if it could not be mapped.
+ *
+ * The kernel can only use a huge page for a range aligned to its size, so one
+ * huge page more is mapped and what lies outside the aligned range is
+ * unmapped.
+ */
+static void *map_transparent(long long size) {
+    char *raw = (char *)mmap(NULL, size + HUGE_PAGE_SIZE,
+                             PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+        return MAP_FAILED;
+
+    char *aligned = (char *)(((uintptr_t)raw + HUGE_PAGE_SIZE - 1) &
+                             ~(uintptr_t)(HUGE_PAGE_SIZE - 1));
+    if (aligned > raw)
+        munmap(raw, aligned - raw);
+    munmap(aligned + size, raw + HUGE_PAGE_SIZE - aligned);
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, size, MADV_HUGEPAGE);
+#endif
+    return aligned;
+}
+
+
+
+void *huge_alloc(long long size, bool prefault) {
+    /* Small buffers still start at a cache line, as arenas expect. */
+    if (size < HUGE_PAGE_SIZE) {
+        void *ptr = NULL;
+        if (size < 1 || posix_memalign(&ptr, ARENA_ALIGNMENT, size) != 0) {
+            fprintf(stderr, "Could not allocate memory of %lld bytes.\n",
+                    size);
+            MPI_Barrier(MPI_COMM_WORLD);
+            MPI_Finalize();
+            exit(EXIT_FAILURE);
+        }
+        return ptr;
+    }
+
+    const long long mapped = huge_size(size);
+    void *ptr = MAP_FAILED;
+#ifdef MAP_HUGETLB
+    ptr = mmap(NULL, mapped, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (ptr == MAP_FAILED)
+        ptr = map_transparent(mapped);
+    if (ptr == MAP_FAILED) {
+        fprintf(stderr, "Could not map memory of %lld bytes.\n", mapped);
+        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Finalize();
+        exit(EXIT_FAILURE);
+    }
+
+    /* Writing a byte of each page makes the kernel back it. */
+    if (prefault) {
+        const long long page = sysconf(_SC_PAGESIZE);
+        volatile char *bytes = (volatile char *)ptr;
+        #pragma omp parallel for schedule(static)
+        for (long long i = 0; i < mapped; i += page)
+            bytes[i] = 0;
+    }
+    return ptr;
+}
+
+
+void huge_free(void *ptr, long long size) {
+    if (ptr == NULL)
+        return;
+    if (size < HUGE_PAGE_SIZE)
+        free(ptr);
+    else
+        munmap(ptr, huge_size(size));
+}
+
+
+void arena_create(struct arena *arena, long long size, bool prefault) {
+    arena->size = size > 0 ? size : 1;
+    arena->base = (char *)huge_alloc(arena->size, prefault);
+    arena->used = 0;
+}
+
+
+void *arena_alloc(struct arena *arena, long long size) {
+    long long start = (arena->used + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT *
+                      ARENA_ALIGNMENT;
+    if (size < 0 || start + size > arena->size) {
+        fprintf(stderr, "Can not take %lld bytes from an arena of %lld.\n",
+                size, arena->size);
+        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Finalize();
+        exit(EXIT_FAILURE);
+    }
+    arena->used = start + size;
+    return arena->base + start;
+}
+
+
+void arena_destroy(struct arena *arena) {
+    huge_free(arena->base, arena->size);
+    arena->base = NULL;
+    arena->size = 0;
+    arena->used = 0;
+}
+
+
+void page_faults_read(struct page_faults *faults) {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    faults->minor = usage.ru_minflt;
+    faults->major = usage.ru_majflt;
+}
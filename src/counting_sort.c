@@ -26,163 +26,1007 @@
 
 #include "counting_sort.h"
 
+#include <limits.h>
 #include <mpi.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#if defined(OPEN_MPI) && MPI_VERSION < 4
+#include <mpi-ext.h>
+#endif
 
+#include "fill.h"
+#include "arena.h"
+#include "histogram.h"
+#include "partition.h"
+#include "planner.h"
+#include "radix_sort.h"
+#include "sample_sort.h"
+#include "segmented_histogram.h"
+#include "sparse_histogram.h"
 #include "util.h"
 
+/**
+ * @brief In single pass mode, the values are counted right away only while the
+ *        range [min; max] is at most this many times the number of elements;
+ *        wider ranges are left to the planner.
+ */
+#define SPARSE_RANGE_RATIO 4
 
 /**
- * @brief Return a positive integer representation of the item to use as index
- *        in an array.
- * @param item: The item to hash.
- * @return Positive integer key associated to the item.
- *
- * This is similar to an hash function; to be used when the elements stored in
- * the array are not all positive integers or not integers at all.
+ * @brief Number of elements counted, in pipelined mode, between two calls
+ *        letting MPI progress the pending reduction.
  */
-static int key(int item) {
-    return item;
-}
+#define PIPELINE_POLL_ELEMENTS (1 << 20)
 
+/*
+ * Persistent collective operations are part of MPI 4; Open MPI provides them
+ * earlier as an extension.
+ */
+#if MPI_VERSION >= 4
+#define PERSISTENT_ALLREDUCE_INIT MPI_Allreduce_init
+#define PERSISTENT_ALLGATHERV_INIT MPI_Allgatherv_init
+#elif defined(OMPI_HAVE_MPI_EXT_PCOLLREQ) && OMPI_HAVE_MPI_EXT_PCOLLREQ
+#define PERSISTENT_ALLREDUCE_INIT MPIX_Allreduce_init
+#define PERSISTENT_ALLGATHERV_INIT MPIX_Allgatherv_init
+#endif
 
 
 /**
- * @brief Find the minimum and maximum value stored in the array using MPI
- *        communication.
- * @param array:    The array.
- * @param size:     Number of elements in the array.
- * @param min:      Minimum value (output).
- * @param max:      Maximum value (output).
- * @param num_proc: Number of MPI processes.
- * @param rank:     Rank of the process calling the function.
+ * @brief Number of occurrences of each value stored in the whole array, in
+ *        either dense or sparse representation.
  */
-static void find_min_max(int *array, long long size, int *min, int *max,
-                         int num_proc, int rank)
+struct histogram {
+    /** Minimum value stored in the array. */
+    int min;
+    /** Maximum value stored in the array. */
+    int max;
+    /** Dense representation: one counter for every value in [min; max]. */
+    int *count;
+    /** Same as `count`, with 64-bit counters, for arrays too long for it. */
+    long long *wide_count;
+    /** Sparse representation: only the values that occur, sorted. */
+    struct run *runs;
+    /** Number of runs in the sparse representation. */
+    long long num_runs;
+};
+
+
+/**
+ * @brief Find the minimum and maximum value stored in a distributed array using
+ *        MPI communication.
+ * @param local_array: Portion of the array owned by the calling process.
+ * @param local_size:  Number of elements in the portion.
+ * @param min:         Minimum value (output).
+ * @param max:         Maximum value (output).
+ * @param topo:        Topology of the processes; `NULL` to reduce flat.
+ */
+static void find_min_max(const int *local_array, long long local_size,
+                         int *min, int *max, const struct topology *topo)
 {
-    int local_min = RANGE_MAX;
-    int local_max = RANGE_MIN;
+    /* Neutral values for the reductions, kept if the portion is empty. */
+    int local_min = INT_MAX;
+    int local_max = INT_MIN;
 
-    /* Divide the total size evenly among every process. */
-    const long long local_size = size / num_proc;
+    /* Each process finds a local minimum and maximum value in its portion. */
+    if (local_size > 0)
+        array_min_max(local_array, local_size, &local_min, &local_max);
 
     /*
-     * Each process (except the first one) will work on a precise sub-portion of
-     * the array, finding a local minimum and local maximum value.
-     */
-    if (rank > 0)
-        array_min_max(&array[(rank - 1) * local_size], local_size, &local_min,
-                      &local_max);
-    /*
-     * Process with rank 0 has to find local_min and local_max for its portion
-     * of local_size elements AND every element of the array that was left out
-     * from the local_size division.
+     * Find global min and global max among the local ones and share the result
+     * with all processes. Both are found by a single reduction: the bitwise
+     * complement reverses the order of the integers without overflowing, so
+     * the maximum complement is the complement of the minimum.
      */
-    else {
-        /*
-         * This is the number of elements that, when the size is not perfectly
-         * divisible by the number of processes, no process would cover.
-         * It is, at most, equal to num_proc - 1.
-         */
-        int num_leftout = size - local_size * num_proc;
-        array_min_max(&array[(num_proc - 1) * local_size],
-                      local_size + num_leftout, &local_min, &local_max);
+    int extremes[2] = {~local_min, local_max};
+    topology_allreduce(extremes, 2, MPI_INT, MPI_MAX, topo);
+    *min = ~extremes[0];
+    *max = extremes[1];
+}
+
+
+/**
+ * @brief Build the global count[] array of a distributed array, overlapping the
+ *        counting of each chunk of the portion with the reduction of the counts
+ *        of the previous one.
+ * @param local_array: Portion of the array owned by the calling process.
+ * @param local_size:  Number of elements in the portion.
+ * @param min:         Minimum value stored in the whole array.
+ * @param max:         Maximum value stored in the whole array.
+ * @param opts:        Options tuning the algorithm.
+ * @return The count[] array, as global_count(). It must be freed by the caller.
+ *
+ * Every process splits its portion into `opts->pipeline_chunks` chunks. The
+ * counts of each chunk are reduced by MPI_Iallreduce, which runs while the next
+ * chunk is counted, and added to count[] once the reduction is over. Two sets
+ * of buffers are used in turn, so at most one reduction is pending while a
+ * chunk is counted. The processes only call MPI from the main thread, so no
+ * progress thread can be used: MPI_Test is called every
+ * #PIPELINE_POLL_ELEMENTS elements instead, letting MPI progress the pending
+ * reduction.
+ */
+static int *pipelined_count(const int *local_array, long long local_size,
+                            int min, int max, const struct sort_options *opts)
+{
+    const int count_size = max - min + 1;
+    const int chunks = opts->pipeline_chunks;
+
+    int *count = (int *)huge_alloc(count_size * sizeof(int), false);
+    memset(count, 0, count_size * sizeof(int));
+
+    /* Counts of a chunk, and their reduction, for each set of buffers. */
+    int *partial[2], *reduced[2];
+    MPI_Request requests[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+    bool pending[2] = {false, false};
+    for (int b = 0; b < 2; b++) {
+        partial[b] = (int *)huge_alloc(count_size * sizeof(int), false);
+        reduced[b] = (int *)huge_alloc(count_size * sizeof(int), false);
     }
 
     /*
-     * Find global min and global max among the local ones and share the result
-     * with all processes.
+     * The threads count every block in replicas allocated once, which are
+     * summed only when the counts of a chunk are posted.
      */
-    MPI_Allreduce(&local_min, min, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
-    MPI_Allreduce(&local_max, max, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
-}
+    struct histogram_replicas replicas;
+    histogram_replicas_create(&replicas, PIPELINE_POLL_ELEMENTS, min,
+                              count_size, opts->kernel);
 
+    for (int c = 0; c < chunks + 2; c++) {
+        const int b = c % 2;
 
+        /* The buffers are reused once the reduction of chunk c - 2 is over. */
+        if (pending[b]) {
+            MPI_Wait(&requests[b], MPI_STATUS_IGNORE);
+            for (int i = 0; i < count_size; i++)
+                count[i] += reduced[b][i];
+            pending[b] = false;
+        }
+        /* The last two steps only collect the last two reductions. */
+        if (c >= chunks)
+            continue;
 
-void counting_sort(int *array, long long size, int num_proc, int rank) {
-    int min = 0;
-    int max = 0;
+        const long long first = local_size * c / chunks;
+        const long long last = local_size * (c + 1) / chunks;
+        memset(partial[b], 0, count_size * sizeof(int));
+        for (long long i = first; i < last; i += PIPELINE_POLL_ELEMENTS) {
+            long long block = last - i < PIPELINE_POLL_ELEMENTS
+                              ? last - i : PIPELINE_POLL_ELEMENTS;
+            histogram_replicas_add(&replicas, local_array + i, block);
+            if (pending[1 - b]) {
+                int done = 0;
+                MPI_Test(&requests[1 - b], &done, MPI_STATUS_IGNORE);
+            }
+        }
+
+        histogram_replicas_flush(&replicas, partial[b]);
+        MPI_Iallreduce(partial[b], reduced[b], count_size, MPI_INT, MPI_SUM,
+                       MPI_COMM_WORLD, &requests[b]);
+        pending[b] = true;
+    }
 
-    /* Divide the total size evenly among every process. */
-    const long long local_size = size / num_proc;
+    histogram_replicas_free(&replicas);
+    for (int b = 0; b < 2; b++) {
+        huge_free(partial[b], count_size * sizeof(int));
+        huge_free(reduced[b], count_size * sizeof(int));
+    }
+    return count;
+}
 
-    find_min_max(array, size, &min, &max, num_proc, rank);
+
+/**
+ * @brief Build the global count[] array of a distributed array.
+ * @param local_array: Portion of the array owned by the calling process.
+ * @param local_size:  Number of elements in the portion.
+ * @param min:         Minimum value stored in the whole array.
+ * @param max:         Maximum value stored in the whole array.
+ * @param opts:        Options tuning the algorithm.
+ * @return The count[] array, holding the number of occurrences of each value in
+ *         the range [min; max] in the whole array. It must be freed by the
+ *         caller.
+ *
+ * Every process counts the elements of its own portion; the local counts are
+ * then merged and the result is shared with all processes.
+ */
+static int *global_count(const int *local_array, long long local_size, int min,
+                         int max, const struct sort_options *opts)
+{
+    if (opts->pipeline_chunks > 1)
+        return pipelined_count(local_array, local_size, min, max, opts);
 
     /* Size of the count[] array. */
     const int count_size = max - min + 1;
 
     /*
-     * Each process will operate on its local version of the count[] array.
-     * Initialized with all of its items at 0.
+     * Each process will operate on its local version of the count[] array,
+     * backed by huge pages when it is wide: its counters are updated in random
+     * order, so every TLB entry saved counts.
      */
-    int *local_count = (int *)safe_alloc(count_size * sizeof(int));
-    for (int i = 0; i < count_size; i++)
-        local_count[i] = 0;
+    int *count = (int *)huge_alloc(count_size * sizeof(int), false);
+    histogram_count(local_array, local_size, min, count, count_size,
+                    opts->kernel);
 
     /*
-     * Each process will only consider the first `local_size` items it finds in
-     * the input array starting from an offset that depends on the rank and is,
-     * therefore, unique.
+     * Merge every local count[] into the global (and official) version of the
+     * count[] array. The reduction is carried out by MPI with logarithmic depth
+     * and its result is shared with all processes, each of which accumulates
+     * directly in its own buffer. With a topology, the counts are first merged
+     * within each node, so only one process for each node sends them to the
+     * other nodes.
      */
-    long long local_offset = rank * local_size;
-    for (long long i = local_offset; i < local_offset + local_size; i++)
-        local_count[key(array[i]) - min] += 1;
+    topology_allreduce(count, count_size, MPI_INT, MPI_SUM, opts->topology);
+    return count;
+}
 
-    /* ============================== RANK = 0 ============================== */
-    if (rank == 0) {
-        long long k = 0;
 
-        /*
-         * Global (and official) version of the count[] array.
-         * Initialized with all of its items at 0.
-         */
-        int *count = (int *)safe_alloc(count_size * sizeof(int));
+/**
+ * @brief Build the global count[] array of a distributed array with 64-bit
+ *        counters, for arrays longer than `narrow_limit`.
+ * @param local_array: Portion of the array owned by the calling process.
+ * @param local_size:  Number of elements in the portion.
+ * @param min:         Minimum value stored in the whole array.
+ * @param max:         Maximum value stored in the whole array.
+ * @param opts:        Options tuning the algorithm.
+ * @return The count[] array, as global_count(), with 64-bit counters. It must
+ *         be freed by the caller.
+ *
+ * The kernels count in 32-bit counters, so the portion is counted
+ * `narrow_limit` elements at a time, adding the counts of each chunk into the
+ * 64-bit counters; these are merged as they are, twice as many bytes as the
+ * 32-bit ones. Pipelined counting is not used.
+ */
+static long long *wide_global_count(const int *local_array,
+                                    long long local_size, int min, int max,
+                                    const struct sort_options *opts)
+{
+    const int count_size = max - min + 1;
+    long long *wide_count = (long long *)huge_alloc(count_size *
+                                                    sizeof(long long), false);
+    memset(wide_count, 0, count_size * sizeof(long long));
+    int *count = (int *)huge_alloc(count_size * sizeof(int), false);
+
+    for (long long first = 0; first < local_size; first += opts->narrow_limit) {
+        long long chunk = local_size - first < opts->narrow_limit
+                          ? local_size - first : opts->narrow_limit;
+        histogram_count(local_array + first, chunk, min, count, count_size,
+                        opts->kernel);
+        #pragma omp parallel for schedule(static)
         for (int i = 0; i < count_size; i++)
-            count[i] = 0;
+            wide_count[i] += count[i];
+    }
+    huge_free(count, count_size * sizeof(int));
+
+    topology_allreduce(wide_count, count_size, MPI_LONG_LONG, MPI_SUM,
+                       opts->topology);
+    return wide_count;
+}
+
+
+/**
+ * @brief Find the range of the values stored in a distributed array, unless it
+ *        is known in advance.
+ * @param local_array: Portion of the array owned by the calling process.
+ * @param local_size:  Number of elements in the portion.
+ * @param opts:        Options tuning the algorithm.
+ * @param min:         Minimum value (output).
+ * @param max:         Maximum value (output).
+ */
+static void find_range(const int *local_array, long long local_size,
+                       const struct sort_options *opts, int *min, int *max)
+{
+    if (opts->range_known) {
+        *min = opts->range_min;
+        *max = opts->range_max;
+    }
+    else
+        find_min_max(local_array, local_size, min, max, opts->topology);
+}
+
+
+/**
+ * @brief Find the minimum and maximum value stored in a distributed array and,
+ *        when possible, build its global count[] array in the same pass.
+ * @param local_array: Portion of the array owned by the calling process.
+ * @param local_size:  Number of elements in the portion.
+ * @param size:        Number of elements in the whole array.
+ * @param opts:        Options tuning the algorithm.
+ * @param min:         Minimum value (output).
+ * @param max:         Maximum value (output).
+ * @return The count[] array of the whole array, to be freed by the caller, if
+ *         it has been built; `NULL` if only min and max have been found.
+ *
+ * Without `single_pass`, with a known range, or when the dense count[] is not
+ * going to be used, this is the same as find_range(). Otherwise, every process
+ * counts its portion into a count[] that grows with the values met, reading
+ * the portion only once; the local extremes are then merged by a single
+ * reduction, after which the local counts are moved to the global range and
+ * merged as well. If count[] would grow wider than the dense engine allows,
+ * in any process, the counts are dropped and the caller has to choose the
+ * engine again.
+ */
+static int *scan_array(const int *local_array, long long local_size,
+                       long long size, const struct sort_options *opts,
+                       int *min, int *max)
+{
+    if (!opts->single_pass || opts->range_known || size > opts->narrow_limit ||
+        (opts->engine != ENGINE_AUTO && opts->engine != ENGINE_DENSE)) {
+        find_range(local_array, local_size, opts, min, max);
+        return NULL;
+    }
+
+    /* Widest count[] worth counting before the planner has a say. */
+    long long max_count_size = INT_MAX;
+    if (opts->engine == ENGINE_AUTO && SPARSE_RANGE_RATIO * size < INT_MAX)
+        max_count_size = SPARSE_RANGE_RATIO * size;
+
+    int local_min = 0, local_max = 0;
+    int *local_count = NULL;
+    bool counted = histogram_count_range(local_array, local_size,
+                                         max_count_size, &local_min,
+                                         &local_max, &local_count);
+
+    /* Same reduction as find_min_max(), also telling if anyone gave up. */
+    int extremes[3] = {~local_min, local_max, !counted};
+    topology_allreduce(extremes, 3, MPI_INT, MPI_MAX, opts->topology);
+    *min = ~extremes[0];
+    *max = extremes[1];
+
+    const long long count_size = (long long)*max - *min + 1;
+    if (extremes[2] || count_size > max_count_size) {
+        free(local_count);
+        return NULL;
+    }
+
+    /* The local range is part of the global one: shift the local counters. */
+    int *count = (int *)huge_alloc(count_size * sizeof(int), false);
+    memset(count, 0, count_size * sizeof(int));
+    if (local_count != NULL)
+        memcpy(count + (local_min - *min), local_count,
+               ((long long)local_max - local_min + 1) * sizeof(int));
+    free(local_count);
+
+    topology_allreduce(count, count_size, MPI_INT, MPI_SUM, opts->topology);
+    return count;
+}
+
+
+/**
+ * @brief Write the elements of the sorted array that fall in the positions
+ *        [first; last), according to the global count[] array.
+ * @param out:    Where to write the elements; `out[0]` is position `first`.
+ * @param count:  Number of occurrences of each value in the range [min; max].
+ * @param wide:   Same as count[], with 64-bit counters; `NULL` to use count[].
+ * @param min:    Minimum value stored in the array.
+ * @param max:    Maximum value stored in the array.
+ * @param first:  First position (inclusive) of the sorted array to write.
+ * @param last:   Last position (exclusive) of the sorted array to write.
+ * @param starts: Buffer of `max - min + 2` items for the prefix sum.
+ *
+ * The prefix sum of count[] gives the position where each value starts in the
+ * sorted array, so the value at any position is found by binary search and
+ * the output can be split among threads by position, equally balanced however
+ * skewed the values are. Always inlined, so that callers with constant bounds
+ * get loops specialised for them. Each run is written by fill_run(), with
+ * non-temporal stores if the output exceeds the cache.
+ */
+static inline __attribute__((always_inline))
+void expand_range(int *out, const int *count, const long long *wide,
+                  int min, int max, long long first, long long last,
+                  long long *starts)
+{
+    const long long count_size = (long long)max - min + 1;
+
+    /* Position where the run of each value starts in the sorted array. */
+    starts[0] = 0;
+    if (wide != NULL)
+        for (long long i = 0; i < count_size; i++)
+            starts[i + 1] = starts[i] + wide[i];
+    else
+        for (long long i = 0; i < count_size; i++)
+            starts[i + 1] = starts[i] + count[i];
+
+    /*
+     * The positions to write are split evenly among the threads, whatever the
+     * length of the runs: each thread finds the run its part starts in and
+     * writes up to the end of its part, even if that is in the middle of a run.
+     */
+    const bool streaming = fill_streaming(last - first);
+    #pragma omp parallel num_threads(fill_threads(last - first))
+    {
+        long long begin = 0, end = 0;
+        fill_slice(first, last, &begin, &end);
+
+        long long k = begin;
+        for (long long i = fill_find_run(starts, count_size, begin); k < end;
+             i++) {
+            long long run_end = starts[i + 1] < end ? starts[i + 1] : end;
+            fill_run(out + (k - first), run_end - k, min + i, streaming);
+            k = run_end;
+        }
+        fill_end(streaming);
+    }
+}
+
+
+/**
+ * @brief Write the elements of the sorted array that fall in the positions
+ *        [first; last), according to the global count[] array.
+ * @param out:    Where to write the elements; `out[0]` is position `first`.
+ * @param count:  Number of occurrences of each value in the range [min; max].
+ * @param wide:   Same as count[], with 64-bit counters; `NULL` to use count[].
+ * @param min:    Minimum value stored in the array.
+ * @param max:    Maximum value stored in the array.
+ * @param first:  First position (inclusive) of the sorted array to write.
+ * @param last:   Last position (exclusive) of the sorted array to write.
+ * @param starts: Buffer of `max - min + 2` items for the prefix sum; `NULL` to
+ *                allocate one for the call.
+ *
+ * Ranges known at compile time, the same ones with a specialised counting
+ * kernel, get their own copy of the loops with constant bounds.
+ */
+static void expand_block(int *out, const int *count, const long long *wide,
+                         int min, int max, long long first, long long last,
+                         long long *starts)
+{
+    const long long buffer_size = ((long long)max - min + 2) *
+                                  sizeof(long long);
+    long long *buffer = starts;
+    if (buffer == NULL)
+        buffer = (long long *)huge_alloc(buffer_size, false);
+
+    if (min == 0 && max == UINT8_MAX)
+        expand_range(out, count, wide, 0, UINT8_MAX, first, last, buffer);
+    else if (min == 0 && max == UINT16_MAX)
+        expand_range(out, count, wide, 0, UINT16_MAX, first, last, buffer);
+    else if (min == RANGE_MIN && max == RANGE_MAX)
+        expand_range(out, count, wide, RANGE_MIN, RANGE_MAX, first, last,
+                     buffer);
+    else
+        expand_range(out, count, wide, min, max, first, last, buffer);
+
+    if (starts == NULL)
+        huge_free(buffer, buffer_size);
+}
+
+
+/**
+ * @brief Choose the algorithm to sort a distributed array with.
+ * @param local_array: Portion of the array owned by the calling process.
+ * @param local_size:  Number of elements in the portion.
+ * @param size:        Number of elements in the whole array.
+ * @param min:         Minimum value stored in the whole array.
+ * @param max:         Maximum value stored in the whole array.
+ * @param counted:     Whether scan_array() has already built the dense
+ *                     count[] array.
+ * @param replicated:  Whether every process ends up with the whole sorted
+ *                     array.
+ * @param opts:        Options tuning the algorithm.
+ * @param num_proc:    Number of MPI processes.
+ * @return The algorithm chosen in the options, or the one the planner expects
+ *         to be the fastest if the options leave the choice open.
+ */
+static enum sort_engine choose_engine(const int *local_array,
+                                      long long local_size, long long size,
+                                      int min, int max, bool counted,
+                                      bool replicated,
+                                      const struct sort_options *opts,
+                                      int num_proc)
+{
+    /*
+     * Past narrow_limit, the dense engine counts in 64-bit counters and the
+     * radix and sample engines exchange elements with large counts; the
+     * sparse and comparison engines only handle int counts.
+     */
+    const bool wide = size > opts->narrow_limit;
+    const bool wide_range = (long long)max - min >= INT_MAX;
+    if (wide && (opts->engine == ENGINE_SPARSE ||
+                 opts->engine == ENGINE_COMPARISON)) {
+        fprintf(stderr, "The %s engine can not sort more than %lld "
+                        "elements.\n", sort_engine_name(opts->engine),
+                opts->narrow_limit);
+        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Finalize();
+        exit(EXIT_FAILURE);
+    }
+    if (wide && wide_range && opts->engine == ENGINE_DENSE) {
+        fprintf(stderr, "The dense engine can not sort more than %lld "
+                        "elements in a range of more than %d values.\n",
+                opts->narrow_limit, INT_MAX);
+        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Finalize();
+        exit(EXIT_FAILURE);
+    }
+
+    struct sort_decision decision;
+    plan_engine(local_array, local_size, size, min, max,
+                counted ? ENGINE_DENSE : opts->engine, opts->radix_bits,
+                replicated, num_proc, &decision);
+
+    /* Left to choose, the cheapest of the engines able to is taken. */
+    if (wide && (decision.engine == ENGINE_SPARSE ||
+                 decision.engine == ENGINE_COMPARISON ||
+                 (decision.engine == ENGINE_DENSE && wide_range))) {
+        decision.engine = ENGINE_SAMPLE;
+        if (decision.cost[ENGINE_RADIX] < decision.cost[decision.engine])
+            decision.engine = ENGINE_RADIX;
+        if (!wide_range &&
+            decision.cost[ENGINE_DENSE] < decision.cost[decision.engine])
+            decision.engine = ENGINE_DENSE;
+    }
+    if (opts->decision != NULL)
+        *opts->decision = decision;
+    return decision.engine;
+}
+
+
+/**
+ * @brief Sort a distributed array with a dense count[], each process keeping
+ *        the merged counts of one segment of the range only.
+ * @param local_array: Portion of the array owned by the calling process.
+ * @param local_size:  Number of elements in the portion.
+ * @param min:         Minimum value stored in the whole array.
+ * @param max:         Maximum value stored in the whole array.
+ * @param opts:        Options tuning the algorithm.
+ * @param num_proc:    Number of MPI processes.
+ * @param rank:        Rank of the process calling the function.
+ */
+static void segmented_sort(int *local_array, long long local_size, int min,
+                           int max, const struct sort_options *opts,
+                           int num_proc, int rank)
+{
+    /* Position of the portion of every process in the whole array. */
+    long long *offsets = (long long *)safe_alloc((num_proc + 1) *
+                                                 sizeof(long long));
+    offsets[0] = 0;
+    MPI_Allgather(&local_size, 1, MPI_LONG_LONG, offsets + 1, 1, MPI_LONG_LONG,
+                  MPI_COMM_WORLD);
+    for (int i = 1; i <= num_proc; i++)
+        offsets[i] += offsets[i - 1];
+
+    /* The runs received cover exactly the positions of the portion. */
+    long long num_runs = 0;
+    struct run *runs = segmented_count(local_array, local_size, min, max,
+                                       offsets, opts->kernel, num_proc, rank,
+                                       &num_runs);
+    sparse_expand(local_array, runs, num_runs, 0, local_size);
+
+    free(runs);
+    free(offsets);
+}
+
+
+/**
+ * @brief Sort a distributed array with a comparison sort, after collecting the
+ *        whole array in every process.
+ * @param local_array:  Portion of the array owned by the calling process.
+ * @param local_size:   Number of elements in the portion.
+ * @param local_offset: Position of the portion in the whole array.
+ * @param size:         Number of elements in the whole array.
+ * @param num_proc:     Number of MPI processes.
+ */
+static void comparison_sort(int *local_array, long long local_size,
+                            long long local_offset, long long size,
+                            int num_proc)
+{
+    int *array = (int *)safe_alloc((size > 0 ? size : 1) * sizeof(int));
+    int *counts = (int *)safe_alloc(num_proc * sizeof(int));
+    int *displs = (int *)safe_alloc(num_proc * sizeof(int));
+
+    const int count = local_size;
+    MPI_Allgather(&count, 1, MPI_INT, counts, 1, MPI_INT, MPI_COMM_WORLD);
+    displs[0] = 0;
+    for (int i = 1; i < num_proc; i++)
+        displs[i] = displs[i - 1] + counts[i - 1];
+    MPI_Allgatherv(local_array, count, MPI_INT, array, counts, displs, MPI_INT,
+                   MPI_COMM_WORLD);
+
+    /* Every process sorts the same array and keeps its own positions. */
+    qsort(array, size, sizeof(int), compare_ints);
+    memcpy(local_array, array + local_offset, local_size * sizeof(int));
+
+    free(array);
+    free(counts);
+    free(displs);
+}
+
+
+/**
+ * @brief Build the histogram of a distributed array.
+ * @param local_array: Portion of the array owned by the calling process.
+ * @param local_size:  Number of elements in the portion.
+ * @param size:        Number of elements in the whole array.
+ * @param engine:      Either #ENGINE_DENSE or #ENGINE_SPARSE.
+ * @param min:         Minimum value stored in the whole array.
+ * @param max:         Maximum value stored in the whole array.
+ * @param count:       Global count[] array already built by scan_array(), which
+ *                     the histogram takes ownership of; `NULL` if none.
+ * @param opts:        Options tuning the algorithm.
+ * @param hist:        The histogram (output). It must be released with
+ *                     histogram_free().
+ * @param num_proc:    Number of MPI processes.
+ * @param rank:        Rank of the process calling the function.
+ */
+static void global_histogram(const int *local_array, long long local_size,
+                             long long size, enum sort_engine engine, int min,
+                             int max, int *count,
+                             const struct sort_options *opts,
+                             struct histogram *hist, int num_proc, int rank)
+{
+    hist->min = min;
+    hist->max = max;
+    hist->count = count;
+    hist->wide_count = NULL;
+    hist->runs = NULL;
+    hist->num_runs = 0;
+
+    if (count != NULL)
+        return;
+    if (engine == ENGINE_SPARSE) {
+        hist->runs = sparse_count(local_array, local_size, &hist->num_runs);
+        hist->runs = sparse_reduce(hist->runs, &hist->num_runs, num_proc, rank);
+    }
+    else if (size > opts->narrow_limit)
+        hist->wide_count = wide_global_count(local_array, local_size, min, max,
+                                             opts);
+    else
+        hist->count = global_count(local_array, local_size, min, max, opts);
+}
+
+
+/**
+ * @brief Write the elements of the sorted array that fall in the positions
+ *        [first; last), according to the histogram of the array.
+ * @param out:   Where to write the elements; `out[0]` is position `first`.
+ * @param hist:  Histogram of the whole array.
+ * @param first: First position (inclusive) of the sorted array to write.
+ * @param last:  Last position (exclusive) of the sorted array to write.
+ */
+static void histogram_expand(int *out, const struct histogram *hist,
+                             long long first, long long last)
+{
+    if (hist->runs != NULL)
+        sparse_expand(out, hist->runs, hist->num_runs, first, last);
+    else
+        expand_block(out, hist->count, hist->wide_count, hist->min, hist->max,
+                     first, last, NULL);
+}
+
+
+/**
+ * @brief Release the memory held by a histogram.
+ * @param hist: The histogram.
+ */
+static void histogram_free(struct histogram *hist) {
+    const long long count_size = (long long)hist->max - hist->min + 1;
+    huge_free(hist->count, count_size * sizeof(int));
+    huge_free(hist->wide_count, count_size * sizeof(long long));
+    free(hist->runs);
+}
+
+
+void sort_options_init(struct sort_options *opts) {
+    opts->expand = EXPAND_GATHER;
+    opts->engine = ENGINE_AUTO;
+    opts->radix_bits = 11;
+    opts->kernel = KERNEL_AUTO;
+    opts->single_pass = false;
+    opts->range_known = false;
+    opts->range_min = RANGE_MIN;
+    opts->range_max = RANGE_MAX;
+    opts->pipeline_chunks = 0;
+    opts->segmented = false;
+    opts->narrow_limit = INT_MAX;
+    opts->topology = NULL;
+    opts->decision = NULL;
+}
+
+
+void counting_sort(int *array, long long size, int num_proc, int rank) {
+    struct sort_options opts;
+    sort_options_init(&opts);
+    counting_sort_opts(array, size, &opts, num_proc, rank);
+}
+
+
+void counting_sort_opts(int *array, long long size,
+                        const struct sort_options *opts, int num_proc,
+                        int rank)
+{
+    int min = 0;
+    int max = 0;
+
+    /*
+     * Each process counts the elements of its own portion of the array, which
+     * starts from an offset that depends on the rank and is, therefore, unique.
+     */
+    long long local_offset = 0, local_size = 0;
+    array_block(size, num_proc, rank, &local_offset, &local_size);
+
+    int *count = scan_array(array + local_offset, local_size, size, opts, &min,
+                            &max);
+    enum sort_engine engine = choose_engine(array + local_offset, local_size,
+                                            size, min, max, count != NULL,
+                                            true, opts, num_proc);
+
+    /* Every process sorts the whole array by itself, once it is collected. */
+    if (engine == ENGINE_COMPARISON) {
+        array_gather(array, MPI_INT, size, num_proc);
+        qsort(array, size, sizeof(int), compare_ints);
+        return;
+    }
+
+    if (engine == ENGINE_RADIX)
+        radix_sort_dist(array + local_offset, local_size, min, max,
+                        opts->radix_bits, num_proc, rank);
+    else if (engine == ENGINE_SAMPLE)
+        sample_sort_dist(array + local_offset, local_size, num_proc, rank);
+    else if (engine == ENGINE_DENSE && count == NULL && opts->segmented &&
+             size <= opts->narrow_limit)
+        segmented_sort(array + local_offset, local_size, min, max, opts,
+                       num_proc, rank);
+    else {
+        struct histogram hist;
+        global_histogram(array + local_offset, local_size, size, engine, min,
+                         max, count, opts, &hist, num_proc, rank);
 
         /*
-         * The size might not always be perfectly divisible by the number of
-         * processes; in such cases, a portion of the array might be left out.
-         * This is the position in the array where the left out elements start.
+         * Only the histogram has been shared: every process rebuilds the
+         * whole sorted array by itself and no further communication is needed.
          */
-        long long index_leftout = local_size * num_proc;
-        /* Process 0 has to also consider the left out elements (if any). */
-        for (long long i = index_leftout; i < size; i++)
-            local_count[key(array[i]) - min] += 1;
+        if (opts->expand == EXPAND_LOCAL) {
+            histogram_expand(array, &hist, 0, size);
+            histogram_free(&hist);
+            return;
+        }
 
         /*
-         * Receive all the other local_count[] (except for the one already
-         * belonging to process 0) and sum their content to that of count[].
-         * 'i' represents the process rank.
+         * Every process rebuilds only its own portion of the sorted array: the
+         * same one it counted the elements of.
          */
-        for (int i = 0; i < num_proc; i++) {
-            if (i > 0)
-                MPI_Recv(local_count, count_size, MPI_INT, i, 2, MPI_COMM_WORLD,
-                         MPI_STATUS_IGNORE);
-            for (int j = 0; j < count_size; j++)
-                count[j] += local_count[j];
-        }
+        histogram_expand(array + local_offset, &hist, local_offset,
+                         local_offset + local_size);
+        histogram_free(&hist);
+    }
+
+    /*
+     * By the end of the algorithm, every process only holds its own sorted
+     * portion; with a call to MPI_Allgatherv, all portions are collected into
+     * the array of every process.
+     */
+    array_gather(array, MPI_INT, size, num_proc);
+}
 
-        /* Final section of the algorithm, not parallelizable. */
-        for (int i = min; i < max + 1; i++)
-            for (long long j = 0; j < count[i - min]; j++)
-                array[k++] = i;
 
-        free(count);
+void counting_sort_dist(int *local_array, long long local_size,
+                        const struct sort_options *opts, int num_proc,
+                        int rank)
+{
+    int min = 0;
+    int max = 0;
+
+    /*
+     * The sorted portion owned by the process starts where the portions of all
+     * the processes with lower rank end.
+     */
+    long long local_offset = 0, size = 0;
+    MPI_Exscan(&local_size, &local_offset, 1, MPI_LONG_LONG, MPI_SUM,
+               MPI_COMM_WORLD);
+    if (rank == 0)
+        local_offset = 0;
+    MPI_Allreduce(&local_size, &size, 1, MPI_LONG_LONG, MPI_SUM,
+                  MPI_COMM_WORLD);
+
+    int *count = scan_array(local_array, local_size, size, opts, &min, &max);
+    enum sort_engine engine = choose_engine(local_array, local_size, size, min,
+                                            max, count != NULL, false, opts,
+                                            num_proc);
+
+    if (engine == ENGINE_COMPARISON) {
+        comparison_sort(local_array, local_size, local_offset, size, num_proc);
+        return;
+    }
+    if (engine == ENGINE_RADIX) {
+        radix_sort_dist(local_array, local_size, min, max, opts->radix_bits,
+                        num_proc, rank);
+        return;
+    }
+    if (engine == ENGINE_SAMPLE) {
+        sample_sort_dist(local_array, local_size, num_proc, rank);
+        return;
+    }
+    if (engine == ENGINE_DENSE && count == NULL && opts->segmented &&
+        size <= opts->narrow_limit) {
+        segmented_sort(local_array, local_size, min, max, opts, num_proc,
+                       rank);
+        return;
     }
 
-    /* ============================== RANK > 0 ============================== */
-    else {
-        /* Send local_count[] array back to process 0. */
-        MPI_Send(local_count, count_size, MPI_INT, 0, 2, MPI_COMM_WORLD);
+    struct histogram hist;
+    global_histogram(local_array, local_size, size, engine, min, max, count,
+                     opts, &hist, num_proc, rank);
+    histogram_expand(local_array, &hist, local_offset,
+                     local_offset + local_size);
+    histogram_free(&hist);
+}
+
+
+void counting_sort_shared(struct node_array *array, long long size,
+                          const struct sort_options *opts, int num_proc,
+                          int rank)
+{
+    long long local_offset = 0, local_size = 0;
+    array_block(size, num_proc, rank, &local_offset, &local_size);
+
+    /*
+     * The portion of each process is sorted as a distributed array: counting
+     * reads it, and the expansion writes it, right in the shared memory. The
+     * nodes of the array also group the reductions, unless told otherwise.
+     */
+    struct sort_options node_opts = *opts;
+    if (node_opts.topology == NULL)
+        node_opts.topology = &array->topology;
+    counting_sort_dist(array->data + local_offset, local_size, &node_opts,
+                       num_proc, rank);
+    node_array_gather(array, size, num_proc);
+}
+
+
+void counting_sort_kv(int *keys, void *payload, size_t payload_size,
+                      long long size, const struct sort_options *opts,
+                      int num_proc, int rank)
+{
+    long long local_offset = 0, local_size = 0;
+    array_block(size, num_proc, rank, &local_offset, &local_size);
+
+    counting_sort_kv_dist(keys + local_offset,
+                          (char *)payload + local_offset * payload_size,
+                          payload_size, local_size, opts, num_proc, rank);
+
+    /* Payloads are collected as opaque blocks of bytes. */
+    MPI_Datatype payload_type;
+    MPI_Type_contiguous(payload_size, MPI_BYTE, &payload_type);
+    MPI_Type_commit(&payload_type);
+    array_gather(keys, MPI_INT, size, num_proc);
+    array_gather(payload, payload_type, size, num_proc);
+    MPI_Type_free(&payload_type);
+}
+
+
+void counting_sort_kv_dist(int *local_keys, void *local_payload,
+                           size_t payload_size, long long local_size,
+                           const struct sort_options *opts, int num_proc,
+                           int rank)
+{
+    int min = 0;
+    int max = 0;
+
+    find_range(local_keys, local_size, opts, &min, &max);
+
+    /*
+     * When the range fits in a single digit, Radix Sort makes exactly one
+     * Counting Sort pass over the whole range.
+     */
+    const unsigned range = (unsigned)max - (unsigned)min;
+    int bits = opts->radix_bits;
+    if ((range >> RADIX_MAX_BITS) == 0)
+        bits = RADIX_MAX_BITS;
+
+    radix_sort_kv_dist(local_keys, local_payload, payload_size, local_size,
+                       min, max, bits, num_proc, rank);
+}
+
+
+void sort_plan_create(struct sort_plan *plan, int *array, long long size,
+                      int min, int max, const struct sort_options *opts,
+                      MPI_Comm comm)
+{
+    /* The portions are gathered with int counts and offsets. */
+    if (size > INT_MAX) {
+        fprintf(stderr, "A sort plan can not hold more than %d elements.\n",
+                INT_MAX);
+        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Finalize();
+        exit(EXIT_FAILURE);
+    }
+    /* Counters and the reduction of count[] are sized by int. */
+    if ((long long)max - min >= INT_MAX) {
+        fprintf(stderr, "A sort plan can not count a range of more than %d "
+                        "values.\n", INT_MAX);
+        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Finalize();
+        exit(EXIT_FAILURE);
     }
 
-    free(local_count);
+    plan->array = array;
+    plan->size = size;
+    plan->min = min;
+    plan->max = max;
+    plan->kernel = opts->kernel;
+    MPI_Comm_dup(comm, &plan->comm);
+    MPI_Comm_size(plan->comm, &plan->num_proc);
+    MPI_Comm_rank(plan->comm, &plan->rank);
+    array_block(size, plan->num_proc, plan->rank, &plan->local_offset,
+                &plan->local_size);
+
+    plan->count_size = max - min + 1;
+    plan->count = (int *)huge_alloc(plan->count_size * sizeof(int), true);
+    plan->starts = (long long *)huge_alloc((plan->count_size + 1LL) *
+                                           sizeof(long long), true);
+    plan->portion_sizes = (int *)safe_alloc(plan->num_proc * sizeof(int));
+    plan->portion_offsets = (int *)safe_alloc(plan->num_proc * sizeof(int));
+    for (int i = 0; i < plan->num_proc; i++) {
+        long long offset_i = 0, size_i = 0;
+        array_block(size, plan->num_proc, i, &offset_i, &size_i);
+        plan->portion_sizes[i] = size_i;
+        plan->portion_offsets[i] = offset_i;
+    }
 
     /*
-     * By the end of the algorithm, the array is only sorted in the process
-     * with rank 0; with a call to MPI_Bcast, the sorted copy is sent to all the
-     * other processes.
+     * Where persistent collective operations are available, they are set up
+     * once: each execution only starts them again on the same buffers.
      */
-    MPI_Bcast(array, size, MPI_INT, 0, MPI_COMM_WORLD);
+    plan->reduce_request = MPI_REQUEST_NULL;
+    plan->gather_request = MPI_REQUEST_NULL;
+#ifdef PERSISTENT_ALLREDUCE_INIT
+    PERSISTENT_ALLREDUCE_INIT(MPI_IN_PLACE, plan->count, plan->count_size,
+                              MPI_INT, MPI_SUM, plan->comm, MPI_INFO_NULL,
+                              &plan->reduce_request);
+    PERSISTENT_ALLGATHERV_INIT(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, plan->array,
+                               plan->portion_sizes, plan->portion_offsets,
+                               MPI_INT, plan->comm, MPI_INFO_NULL,
+                               &plan->gather_request);
+#endif
+
+    plan->executions = 0;
+    plan->last_time = 0;
+    plan->total_time = 0;
+}
+
+
+double sort_plan_execute(struct sort_plan *plan) {
+    const double start = MPI_Wtime();
+
+    histogram_count(plan->array + plan->local_offset, plan->local_size,
+                    plan->min, plan->count, plan->count_size, plan->kernel);
+    if (plan->reduce_request != MPI_REQUEST_NULL) {
+        MPI_Start(&plan->reduce_request);
+        MPI_Wait(&plan->reduce_request, MPI_STATUS_IGNORE);
+    }
+    else
+        MPI_Allreduce(MPI_IN_PLACE, plan->count, plan->count_size, MPI_INT,
+                      MPI_SUM, plan->comm);
+
+    expand_block(plan->array + plan->local_offset, plan->count, NULL,
+                 plan->min, plan->max, plan->local_offset,
+                 plan->local_offset + plan->local_size, plan->starts);
+
+    if (plan->gather_request != MPI_REQUEST_NULL) {
+        MPI_Start(&plan->gather_request);
+        MPI_Wait(&plan->gather_request, MPI_STATUS_IGNORE);
+    }
+    else
+        MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, plan->array,
+                       plan->portion_sizes, plan->portion_offsets, MPI_INT,
+                       plan->comm);
+
+    plan->last_time = MPI_Wtime() - start;
+    plan->total_time += plan->last_time;
+    plan->executions++;
+    return plan->last_time;
+}
+
+
+void sort_plan_free(struct sort_plan *plan) {
+    /* A persistent request stays valid after each completion. */
+    if (plan->reduce_request != MPI_REQUEST_NULL)
+        MPI_Request_free(&plan->reduce_request);
+    if (plan->gather_request != MPI_REQUEST_NULL)
+        MPI_Request_free(&plan->gather_request);
+    MPI_Comm_free(&plan->comm);
+
+    huge_free(plan->count, plan->count_size * sizeof(int));
+    huge_free(plan->starts, (plan->count_size + 1LL) * sizeof(long long));
+    free(plan->portion_sizes);
+    free(plan->portion_offsets);
 }
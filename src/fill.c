@@ -0,0 +1,165 @@
+/**
+ * @file fill.c
+ * @brief This file contains the kernel writing runs of equal values, which
+ *        rebuild the sorted array from its histogram.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "fill.h"
+
+#include <stdint.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <emmintrin.h>
+/** @brief SSE2 stores, part of every x86-64 CPU, are available. */
+#define FILL_X86
+#endif
+
+/** @brief Size in bytes of a cache line. */
+#define CACHE_LINE 64
+
+/**
+ * @brief Size in bytes of the last level cache assumed when the system does not
+ *        tell it.
+ */
+#define DEFAULT_CACHE_SIZE (8 * 1024 * 1024)
+
+/** @brief Runs shorter than this are written one element at a time. */
+#define FILL_SIMD_MIN 8
+
+/**
+ * @brief Runs shorter than this are never streamed: they would cover few
+ *        whole cache lines, if any.
+ */
+#define FILL_STREAM_MIN 64
+
+/**
+ * @brief Minimum number of elements for each thread to be worth starting it
+ *        to write part of an output.
+ */
+#define FILL_THREAD_MIN 65536
+
+
+
+bool fill_streaming(long long size) {
+    long long cache_size = DEFAULT_CACHE_SIZE;
+#ifdef _SC_LEVEL3_CACHE_SIZE
+    if (sysconf(_SC_LEVEL3_CACHE_SIZE) > 0)
+        cache_size = sysconf(_SC_LEVEL3_CACHE_SIZE);
+#endif
+    return size * (long long)sizeof(int) > cache_size;
+}
+
+
+void fill_run(int *out, long long size, int value, bool streaming) {
+    long long i = 0;
+
+#ifdef FILL_X86
+    /*
+     * The expansion is bound by the memory bandwidth, which 16-byte stores
+     * already saturate; no dispatch on wider instructions is needed.
+     */
+    if (size >= FILL_SIMD_MIN) {
+        const __m128i vector = _mm_set1_epi32(value);
+
+        /*
+         * Non-temporal stores bypass the cache only when they fill whole
+         * lines: the run is written with ordinary stores up to the first line
+         * boundary, then one full line at a time.
+         */
+        if (streaming && size >= FILL_STREAM_MIN) {
+            for (; ((uintptr_t)(out + i) & (CACHE_LINE - 1)) != 0; i++)
+                out[i] = value;
+            for (; i + 16 <= size; i += 16) {
+                _mm_stream_si128((__m128i *)(out + i), vector);
+                _mm_stream_si128((__m128i *)(out + i + 4), vector);
+                _mm_stream_si128((__m128i *)(out + i + 8), vector);
+                _mm_stream_si128((__m128i *)(out + i + 12), vector);
+            }
+        }
+        for (; i + 4 <= size; i += 4)
+            _mm_storeu_si128((__m128i *)(out + i), vector);
+    }
+#else
+    (void)streaming;
+#endif
+
+    for (; i < size; i++)
+        out[i] = value;
+}
+
+
+void fill_end(bool streaming) {
+#ifdef FILL_X86
+    if (streaming)
+        _mm_sfence();
+#else
+    (void)streaming;
+#endif
+}
+
+
+int fill_threads(long long size) {
+#ifdef _OPENMP
+    long long num_threads = omp_get_max_threads();
+    if (num_threads > size / FILL_THREAD_MIN)
+        num_threads = size / FILL_THREAD_MIN;
+    return num_threads > 1 ? num_threads : 1;
+#else
+    (void)size;
+    return 1;
+#endif
+}
+
+
+void fill_slice(long long first, long long last, long long *begin,
+                long long *end)
+{
+#ifdef _OPENMP
+    const long long thread = omp_get_thread_num();
+    const long long num_threads = omp_get_num_threads();
+#else
+    const long long thread = 0;
+    const long long num_threads = 1;
+#endif
+    *begin = first + (last - first) * thread / num_threads;
+    *end = first + (last - first) * (thread + 1) / num_threads;
+}
+
+
+long long fill_find_run(const long long *starts, long long num_runs,
+                        long long position)
+{
+    long long low = 0, high = num_runs - 1;
+    while (low < high) {
+        long long mid = low + (high - low) / 2;
+        if (starts[mid + 1] <= position)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
@@ -0,0 +1,947 @@
+/**
+ * @file histogram.c
+ * @brief This file contains the kernels counting the occurrences of each value
+ *        in an array, which is the core of Counting Sort.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "histogram.h"
+
+#include <limits.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#if defined(__GNUC__) && defined(__x86_64__)
+#include <immintrin.h>
+/** @brief Kernels using x86 vector instructions are available. */
+#define HISTOGRAM_X86
+#endif
+
+#include "arena.h"
+#include "util.h"
+
+/**
+ * @brief Minimum number of elements for each thread to be worth the cost of
+ *        zeroing and summing its replica of count[].
+ */
+#define THREAD_MIN_ELEMENTS 65536
+
+/**
+ * @brief Interleaved kernels are chosen only when there are at least this many
+ *        elements for each counter.
+ */
+#define INTERLEAVE_MIN_RATIO 4
+
+/**
+ * @brief Interleaved kernels are chosen only when count[] has at most this many
+ *        items, so that all of their sub-histograms fit in the L1/L2 cache.
+ */
+#define INTERLEAVE_MAX_COUNT 4096
+
+/**
+ * @brief Number of elements whose minimum and maximum are found, in a single
+ *        pass, just before counting them while they are still in the L1 cache.
+ */
+#define RANGE_BLOCK 2048
+
+/**
+ * @brief Each bucket of the blocked kernel spans at least 2^BLOCKED_BUCKET_BITS
+ *        values, so that its slice of count[] (64 KiB) fits in the L2 cache.
+ */
+#define BLOCKED_BUCKET_BITS 14
+
+/**
+ * @brief Maximum number of buckets of the blocked kernel; wider ranges make
+ *        each bucket span more values.
+ */
+#define BLOCKED_MAX_BUCKETS 1024
+
+/** @brief Number of elements partitioned at a time by the blocked kernel. */
+#define BLOCKED_BLOCK (1 << 22)
+
+/**
+ * @brief The blocked kernel is chosen when count[] has more than this many
+ *        items (16 MiB), beyond the last level cache of most CPUs.
+ */
+#define BLOCKED_MIN_COUNT (1 << 22)
+
+/**
+ * @brief Number of elements sampled to tell whether their counters are spread
+ *        over count[] before choosing the blocked kernel.
+ */
+#define BLOCKED_SAMPLE 1024
+
+/**
+ * @brief The blocked kernel is not chosen when more than 1 / BLOCKED_MAX_REPEAT
+ *        of the sampled elements fall in a cache line of count[] already hit
+ *        by another sampled element.
+ */
+#define BLOCKED_MAX_REPEAT 8
+
+/** @brief Number of counters in a cache line. */
+#define LINE_COUNTERS 16
+
+/** @brief Distance, in elements, of the counters prefetched ahead. */
+#define PREFETCH_DISTANCE 16
+
+/**
+ * @brief The prefetching kernel is chosen when count[] has more than this many
+ *        items (1 MiB), beyond the L2 cache of most CPUs.
+ */
+#define PREFETCH_MIN_COUNT (1 << 18)
+
+/** @brief Number of values in the fixed range [0; 255]. */
+#define FIXED_8BIT_SIZE 256
+
+/** @brief Number of values in the fixed range [0; 65535]. */
+#define FIXED_16BIT_SIZE 65536
+
+
+/** @brief count[] array whose range grows to include every value counted. */
+struct growing_histogram {
+    /** First value of the range of count[]. */
+    int min;
+    /** Last value of the range of count[]. */
+    int max;
+    /** Number of occurrences of each value; `NULL` until the first value. */
+    int *count;
+};
+
+
+/**
+ * @brief Return a positive integer representation of the item to use as index
+ *        in an array.
+ * @param item: The item to hash.
+ * @return Positive integer key associated to the item.
+ *
+ * This is similar to an hash function; to be used when the elements stored in
+ * the array are not all positive integers or not integers at all.
+ */
+static int key(int item) {
+    return item;
+}
+
+
+/**
+ * @brief Add the occurrences of each value in the array to count[], one
+ *        element at a time.
+ * @param array:      The array.
+ * @param size:       Number of elements in the array.
+ * @param min:        Minimum value stored in the array.
+ * @param count:      Number of occurrences of each value (input/output).
+ * @param count_size: Number of items in count[].
+ *
+ * Consecutive elements with the same value update the same counter, so each
+ * update has to wait for the previous one to be stored.
+ */
+static void count_scalar(const int *array, long long size, int min, int *count,
+                         int count_size)
+{
+    (void)count_size;
+    for (long long i = 0; i < size; i++)
+        count[key(array[i]) - min] += 1;
+}
+
+
+/**
+ * @brief Add the occurrences of each value in the array to count[], with the
+ *        loop unrolled 8 times.
+ * @param array: The array.
+ * @param size:  Number of elements in the array.
+ * @param min:   Minimum value stored in the array.
+ * @param count: Number of occurrences of each value (input/output).
+ *
+ * Always inlined, so that every caller passing a constant `min` gets its own
+ * copy of the loop with the offset folded into the addresses.
+ */
+static inline __attribute__((always_inline))
+void count_unrolled(const int *array, long long size, int min, int *count)
+{
+    #pragma GCC unroll 8
+    for (long long i = 0; i < size; i++)
+        count[key(array[i]) - min] += 1;
+}
+
+
+/**
+ * @brief Add the occurrences of each value in the array to count[], for values
+ *        in [0; 255].
+ * @param array: The array.
+ * @param size:  Number of elements in the array.
+ * @param count: Number of occurrences of each value (input/output), with 256
+ *               items.
+ *
+ * Consecutive elements are spread over 4 sub-histograms which, at 4 KiB all
+ * together, live on the stack and never leave the L1 cache.
+ */
+static void count_fixed_8bit(const int *array, long long size, int *count) {
+    int sub[4][FIXED_8BIT_SIZE] = {{0}};
+
+    long long i = 0;
+    #pragma GCC unroll 2
+    for (; i + 4 <= size; i += 4) {
+        sub[0][key(array[i])] += 1;
+        sub[1][key(array[i + 1])] += 1;
+        sub[2][key(array[i + 2])] += 1;
+        sub[3][key(array[i + 3])] += 1;
+    }
+    for (; i < size; i++)
+        sub[0][key(array[i])] += 1;
+
+    for (int j = 0; j < FIXED_8BIT_SIZE; j++)
+        count[j] += sub[0][j] + sub[1][j] + sub[2][j] + sub[3][j];
+}
+
+
+/**
+ * @brief Tell whether a range of values has a kernel specialised for it.
+ * @param min:        First value of the range.
+ * @param count_size: Number of values in the range.
+ * @return `true` if the range is one of the fixed ones; `false` otherwise.
+ */
+static bool fixed_range(int min, int count_size) {
+    return (min == 0 && count_size == FIXED_8BIT_SIZE) ||
+           (min == 0 && count_size == FIXED_16BIT_SIZE) ||
+           (min == RANGE_MIN && count_size == RANGE_MAX - RANGE_MIN + 1);
+}
+
+
+/**
+ * @brief Add the occurrences of each value in the array to count[] with the
+ *        kernel specialised for its range.
+ * @param array:      The array.
+ * @param size:       Number of elements in the array.
+ * @param min:        Minimum value stored in the array.
+ * @param count:      Number of occurrences of each value (input/output).
+ * @param count_size: Number of items in count[].
+ *
+ * The bounds of each fixed range are constants, so the compiler generates a
+ * separate loop for each of them; any other range is counted by the scalar
+ * kernel.
+ */
+static void count_fixed(const int *array, long long size, int min, int *count,
+                        int count_size)
+{
+    if (min == 0 && count_size == FIXED_8BIT_SIZE)
+        count_fixed_8bit(array, size, count);
+    else if (min == 0 && count_size == FIXED_16BIT_SIZE)
+        count_unrolled(array, size, 0, count);
+    else if (min == RANGE_MIN && count_size == RANGE_MAX - RANGE_MIN + 1)
+        count_unrolled(array, size, RANGE_MIN, count);
+    else
+        count_scalar(array, size, min, count, count_size);
+}
+
+
+/**
+ * @brief Allocate the sub-histograms used to interleave the updates of
+ *        consecutive elements.
+ * @param count:      The count[] array, used as first sub-histogram.
+ * @param count_size: Number of items in count[].
+ * @param ways:       Number of sub-histograms.
+ * @param sub:        Pointers to the sub-histograms (output).
+ * @return The memory holding all sub-histograms but the first one, zeroed; it
+ *         must be released with fold_sub_histograms().
+ */
+static int *alloc_sub_histograms(int *count, int count_size, int ways,
+                                 int **sub)
+{
+    int *memory = (int *)safe_alloc((long long)(ways - 1) * count_size *
+                                    sizeof(int));
+    for (long long i = 0; i < (long long)(ways - 1) * count_size; i++)
+        memory[i] = 0;
+
+    sub[0] = count;
+    for (int w = 1; w < ways; w++)
+        sub[w] = memory + (long long)(w - 1) * count_size;
+    return memory;
+}
+
+
+/**
+ * @brief Add all sub-histograms into the first one and release them.
+ * @param memory:     The memory returned by alloc_sub_histograms().
+ * @param count_size: Number of items in count[].
+ * @param ways:       Number of sub-histograms.
+ * @param sub:        Pointers to the sub-histograms.
+ */
+static void fold_sub_histograms(int *memory, int count_size, int ways,
+                                int **sub)
+{
+    for (int i = 0; i < count_size; i++) {
+        int sum = sub[0][i];
+        for (int w = 1; w < ways; w++)
+            sum += sub[w][i];
+        sub[0][i] = sum;
+    }
+    free(memory);
+}
+
+
+/**
+ * @brief Add the occurrences of each value in the array to count[], spreading
+ *        consecutive elements over 4 sub-histograms.
+ * @param array:      The array.
+ * @param size:       Number of elements in the array.
+ * @param min:        Minimum value stored in the array.
+ * @param count:      Number of occurrences of each value (input/output).
+ * @param count_size: Number of items in count[].
+ *
+ * Four consecutive elements with the same value update four different
+ * counters, so the updates no longer wait for each other.
+ */
+static void count_interleaved(const int *array, long long size, int min,
+                              int *count, int count_size)
+{
+    int *sub[4];
+    int *memory = alloc_sub_histograms(count, count_size, 4, sub);
+
+    long long i = 0;
+    for (; i + 4 <= size; i += 4) {
+        sub[0][key(array[i]) - min] += 1;
+        sub[1][key(array[i + 1]) - min] += 1;
+        sub[2][key(array[i + 2]) - min] += 1;
+        sub[3][key(array[i + 3]) - min] += 1;
+    }
+    for (; i < size; i++)
+        sub[0][key(array[i]) - min] += 1;
+
+    fold_sub_histograms(memory, count_size, 4, sub);
+}
+
+
+/**
+ * @brief Add the occurrences of each value in the array to count[], first
+ *        partitioning the elements by the high bits of their value.
+ * @param array:      The array.
+ * @param size:       Number of elements in the array.
+ * @param min:        Minimum value stored in the array.
+ * @param count:      Number of occurrences of each value (input/output).
+ * @param count_size: Number of items in count[].
+ *
+ * When count[] does not fit in the cache, almost every update of a random
+ * element misses. The array is processed in blocks: the elements of a block
+ * are moved, as offsets from `min`, into a buffer grouped by bucket, each
+ * bucket covering a slice of count[] that fits in the L2 cache; the buffer is
+ * then counted bucket after bucket. The partition itself writes to at most
+ * #BLOCKED_MAX_BUCKETS sequential streams, which the cache handles well.
+ */
+static void count_blocked(const int *array, long long size, int min,
+                          int *count, int count_size)
+{
+    /* Each bucket spans 2^shift values. */
+    int shift = BLOCKED_BUCKET_BITS;
+    while (((unsigned)(count_size - 1) >> shift) >= BLOCKED_MAX_BUCKETS)
+        shift++;
+    const int num_buckets = ((unsigned)(count_size - 1) >> shift) + 1;
+    if (num_buckets == 1) {
+        count_scalar(array, size, min, count, count_size);
+        return;
+    }
+
+    const long long block = size < BLOCKED_BLOCK ? size : BLOCKED_BLOCK;
+    unsigned *buffer = (unsigned *)safe_alloc(block * sizeof(unsigned));
+    long long *position = (long long *)safe_alloc(num_buckets *
+                                                  sizeof(long long));
+
+    for (long long first = 0; first < size; first += block) {
+        const long long last = first + block < size ? first + block : size;
+
+        /* Where the elements of each bucket start in the buffer. */
+        for (int b = 0; b < num_buckets; b++)
+            position[b] = 0;
+        for (long long i = first; i < last; i++)
+            position[((unsigned)key(array[i]) - (unsigned)min) >> shift] += 1;
+        long long start = 0;
+        for (int b = 0; b < num_buckets; b++) {
+            long long bucket_size = position[b];
+            position[b] = start;
+            start += bucket_size;
+        }
+
+        for (long long i = first; i < last; i++) {
+            unsigned offset = (unsigned)key(array[i]) - (unsigned)min;
+            buffer[position[offset >> shift]++] = offset;
+        }
+        for (long long i = 0; i < last - first; i++)
+            count[buffer[i]] += 1;
+    }
+
+    free(buffer);
+    free(position);
+}
+
+
+/**
+ * @brief Add the occurrences of each value in the array to count[], one
+ *        element at a time, prefetching the counters of the next elements.
+ * @param array:      The array.
+ * @param size:       Number of elements in the array.
+ * @param min:        Minimum value stored in the array.
+ * @param count:      Number of occurrences of each value (input/output).
+ * @param count_size: Number of items in count[].
+ *
+ * The counter of the element #PREFETCH_DISTANCE positions ahead is requested
+ * before updating the current one, so several cache misses are outstanding at
+ * the same time instead of one after the other.
+ */
+static void count_prefetch(const int *array, long long size, int min,
+                           int *count, int count_size)
+{
+    (void)count_size;
+    long long i = 0;
+    for (; i + PREFETCH_DISTANCE < size; i++) {
+        __builtin_prefetch(&count[key(array[i + PREFETCH_DISTANCE]) - min], 1);
+        count[key(array[i]) - min] += 1;
+    }
+    for (; i < size; i++)
+        count[key(array[i]) - min] += 1;
+}
+
+
+#ifdef HISTOGRAM_X86
+/**
+ * @brief Add the occurrences of each value in the array to count[], 16
+ *        elements at a time with AVX-512 gather and scatter.
+ * @param array:      The array.
+ * @param size:       Number of elements in the array.
+ * @param min:        Minimum value stored in the array.
+ * @param count:      Number of occurrences of each value (input/output).
+ * @param count_size: Number of items in count[].
+ *
+ * VPCONFLICTD tells, for each lane, which lower lanes hold the same value:
+ * every lane adds to its counter one more than the number of such lanes.
+ * Scattered lanes are stored in increasing order, so for every value the last
+ * lane, holding the full increment, is the one that remains in memory.
+ */
+__attribute__((target("avx512f,avx512cd,avx512vpopcntdq")))
+static void count_avx512(const int *array, long long size, int min,
+                         int *count, int count_size)
+{
+    (void)count_size;
+    const __m512i vector_min = _mm512_set1_epi32(min);
+    const __m512i ones = _mm512_set1_epi32(1);
+
+    long long i = 0;
+    for (; i + 16 <= size; i += 16) {
+        __m512i index = _mm512_sub_epi32(_mm512_loadu_si512(array + i),
+                                         vector_min);
+        __m512i increment = _mm512_add_epi32(
+            _mm512_popcnt_epi32(_mm512_conflict_epi32(index)), ones);
+        __m512i counters = _mm512_i32gather_epi32(index, count, 4);
+        _mm512_i32scatter_epi32(count, index,
+                                _mm512_add_epi32(counters, increment), 4);
+    }
+    for (; i < size; i++)
+        count[key(array[i]) - min] += 1;
+}
+#endif /* HISTOGRAM_X86 */
+
+
+/**
+ * @brief Tell whether the counters of the elements of an array are spread over
+ *        count[], rather than gathered on a few cache lines.
+ * @param array: The array; `NULL` if it is not known yet.
+ * @param size:  Number of elements in the array.
+ * @param min:   Minimum value stored in the array.
+ * @return `true` if few regularly spaced elements share a cache line of
+ *         count[] with another one, or if the array is not known.
+ *
+ * The blocked kernel only pays for its extra pass when most increments miss
+ * the cache: on skewed values, such as a Zipf distribution, the hot counters
+ * stay in the cache and counting them in place is faster (see `make bench`).
+ */
+static bool spread_counters(const int *array, long long size, int min) {
+    if (array == NULL || size < BLOCKED_SAMPLE)
+        return true;
+
+    int lines[BLOCKED_SAMPLE];
+    for (int i = 0; i < BLOCKED_SAMPLE; i++)
+        lines[i] = ((long long)array[i * (size / BLOCKED_SAMPLE)] - min) /
+                   LINE_COUNTERS;
+    qsort(lines, BLOCKED_SAMPLE, sizeof(int), compare_ints);
+
+    int repeats = 0;
+    for (int i = 1; i < BLOCKED_SAMPLE; i++)
+        repeats += lines[i] == lines[i - 1];
+    return repeats <= BLOCKED_SAMPLE / BLOCKED_MAX_REPEAT;
+}
+
+
+/**
+ * @brief Choose the kernel to count with.
+ * @param kernel:     The kernel requested.
+ * @param array:      The array; `NULL` if it is not known yet.
+ * @param size:       Number of elements to count.
+ * @param min:        Minimum value stored in the array.
+ * @param count_size: Number of items in count[].
+ * @return The kernel requested, or the one fitting the input if the request
+ *         leaves the choice open.
+ */
+static enum histogram_kernel choose_kernel(enum histogram_kernel kernel,
+                                           const int *array, long long size,
+                                           int min, int count_size)
+{
+    if (kernel != KERNEL_AUTO)
+        return kernel;
+    if (fixed_range(min, count_size))
+        return KERNEL_FIXED;
+
+    /*
+     * Sub-histograms have to be zeroed and summed, which only pays off when
+     * there are many elements for each counter and all the sub-histograms fit
+     * in the cache. On wider ranges the cost is in the cache misses, which
+     * AVX-512 gathers and scatters overlap a little better than scalar code.
+     * Once count[] is larger than the last level cache, partitioning first is
+     * faster than any of them; below that, prefetching hides part of the
+     * misses of the scalar kernel out of the L2 cache; unless the values are
+     * skewed enough that their counters mostly hit the cache anyway.
+     */
+    if (size >= (long long)INTERLEAVE_MIN_RATIO * count_size &&
+        count_size <= INTERLEAVE_MAX_COUNT)
+        return KERNEL_INTERLEAVED;
+    if (count_size > BLOCKED_MIN_COUNT && spread_counters(array, size, min))
+        return KERNEL_BLOCKED;
+    if (count_size > INTERLEAVE_MAX_COUNT &&
+        histogram_kernel_supported(KERNEL_AVX512))
+        return KERNEL_AVX512;
+    if (count_size > PREFETCH_MIN_COUNT)
+        return KERNEL_PREFETCH;
+    return KERNEL_SCALAR;
+}
+
+
+/**
+ * @brief Add the occurrences of each value in the array to count[] with the
+ *        given kernel.
+ * @param array:      The array.
+ * @param size:       Number of elements in the array.
+ * @param min:        Minimum value stored in the array.
+ * @param count:      Number of occurrences of each value (input/output).
+ * @param count_size: Number of items in count[].
+ * @param kernel:     The kernel, other than #KERNEL_AUTO.
+ */
+static void count_with(const int *array, long long size, int min, int *count,
+                       int count_size, enum histogram_kernel kernel)
+{
+    switch (kernel) {
+        case KERNEL_FIXED:
+            count_fixed(array, size, min, count, count_size);
+            break;
+        case KERNEL_INTERLEAVED:
+            count_interleaved(array, size, min, count, count_size);
+            break;
+        case KERNEL_BLOCKED:
+            count_blocked(array, size, min, count, count_size);
+            break;
+        case KERNEL_PREFETCH:
+            count_prefetch(array, size, min, count, count_size);
+            break;
+#ifdef HISTOGRAM_X86
+        case KERNEL_AVX512:
+            count_avx512(array, size, min, count, count_size);
+            break;
+#endif
+        default:
+            count_scalar(array, size, min, count, count_size);
+    }
+}
+
+
+
+/**
+ * @brief Grow the range of a histogram so that it includes [min; max].
+ * @param hist:           The histogram.
+ * @param min:            Lowest value to include.
+ * @param max:            Highest value to include.
+ * @param max_count_size: Maximum number of items in count[].
+ * @return `false` if the range would need more than `max_count_size` items, in
+ *         which case the histogram is left unchanged; `true` otherwise.
+ *
+ * Every time it grows on one side, the range is at least doubled on that side,
+ * so that values drifting further and further away only cost a logarithmic
+ * number of copies of count[].
+ */
+static bool grow_histogram(struct growing_histogram *hist, int min, int max,
+                           long long max_count_size)
+{
+    long long low = min, high = max;
+    if (hist->count != NULL) {
+        const long long width = (long long)hist->max - hist->min + 1;
+        low = hist->min;
+        high = hist->max;
+        if (min < low)
+            low = min < low - width ? min : low - width;
+        if (max > high)
+            high = max > high + width ? max : high + width;
+        if (low < INT_MIN)
+            low = INT_MIN;
+        if (high > INT_MAX)
+            high = INT_MAX;
+
+        /* Without the slack the range could still fit. */
+        if (high - low + 1 > max_count_size) {
+            low = min < hist->min ? min : hist->min;
+            high = max > hist->max ? max : hist->max;
+        }
+    }
+    if (high - low + 1 > max_count_size)
+        return false;
+
+    int *count = (int *)safe_alloc((high - low + 1) * sizeof(int));
+    memset(count, 0, (high - low + 1) * sizeof(int));
+    if (hist->count != NULL) {
+        memcpy(count + (hist->min - low), hist->count,
+               ((long long)hist->max - hist->min + 1) * sizeof(int));
+        free(hist->count);
+    }
+    hist->min = low;
+    hist->max = high;
+    hist->count = count;
+    return true;
+}
+
+
+/**
+ * @brief Count the occurrences of each value in the array while finding its
+ *        minimum and maximum value.
+ * @param array:          The array.
+ * @param size:           Number of elements in the array.
+ * @param max_count_size: Maximum number of items in count[].
+ * @param hist:           Histogram to count in (input/output), empty or not.
+ * @param min:            Minimum value stored in the array (output).
+ * @param max:            Maximum value stored in the array (output).
+ * @return `false` if the range of the values needs more than `max_count_size`
+ *         counters, in which case the histogram is released and only min and
+ *         max are found; `true` otherwise.
+ *
+ * The array is read block by block: the minimum and maximum of each block are
+ * found first, growing the histogram if needed, then the block is counted
+ * while it is still in the cache, so the array is read from memory only once.
+ */
+static bool count_growing(const int *array, long long size,
+                          long long max_count_size,
+                          struct growing_histogram *hist, int *min, int *max)
+{
+    bool counting = true;
+    *min = INT_MAX;
+    *max = INT_MIN;
+
+    for (long long first = 0; first < size; first += RANGE_BLOCK) {
+        const long long last = first + RANGE_BLOCK < size ? first + RANGE_BLOCK
+                                                          : size;
+        int block_min = array[first], block_max = array[first];
+        for (long long i = first + 1; i < last; i++) {
+            if (array[i] < block_min)
+                block_min = array[i];
+            if (array[i] > block_max)
+                block_max = array[i];
+        }
+        if (block_min < *min)
+            *min = block_min;
+        if (block_max > *max)
+            *max = block_max;
+        if (!counting)
+            continue;
+
+        if (hist->count == NULL || block_min < hist->min ||
+            block_max > hist->max)
+            counting = grow_histogram(hist, block_min, block_max,
+                                      max_count_size);
+        if (counting)
+            count_scalar(array + first, last - first, hist->min, hist->count,
+                         hist->max - hist->min + 1);
+        else {
+            free(hist->count);
+            hist->count = NULL;
+        }
+    }
+    return counting;
+}
+
+
+/**
+ * @brief Move the counters of the values in [min; max] to the beginning of the
+ *        count[] array of a histogram.
+ * @param hist: The histogram, whose range includes [min; max].
+ * @param min:  Minimum value counted.
+ * @param max:  Maximum value counted.
+ * @return The count[] array, holding `max - min + 1` counters.
+ */
+static int *shrink_histogram(struct growing_histogram *hist, int min, int max)
+{
+    memmove(hist->count, hist->count + ((long long)min - hist->min),
+            ((long long)max - min + 1) * sizeof(int));
+    return hist->count;
+}
+
+
+
+bool histogram_kernel_supported(enum histogram_kernel kernel) {
+#ifdef HISTOGRAM_X86
+    if (kernel == KERNEL_AVX512)
+        return __builtin_cpu_supports("avx512f") &&
+               __builtin_cpu_supports("avx512cd") &&
+               __builtin_cpu_supports("avx512vpopcntdq");
+#endif
+    return kernel != KERNEL_AVX512;
+}
+
+
+void histogram_count(const int *array, long long size, int min, int *count,
+                     int count_size, enum histogram_kernel kernel)
+{
+    for (int i = 0; i < count_size; i++)
+        count[i] = 0;
+    histogram_add(array, size, min, count, count_size, kernel);
+}
+
+
+void histogram_add(const int *array, long long size, int min, int *count,
+                   int count_size, enum histogram_kernel kernel)
+{
+    kernel = choose_kernel(kernel, array, size, min, count_size);
+    if (!histogram_kernel_supported(kernel))
+        kernel = KERNEL_SCALAR;
+
+#ifdef _OPENMP
+    int max_threads = omp_get_max_threads();
+    if (max_threads > size / THREAD_MIN_ELEMENTS)
+        max_threads = size / THREAD_MIN_ELEMENTS;
+#else
+    int max_threads = 1;
+#endif
+    if (max_threads < 2) {
+        count_with(array, size, min, count, count_size, kernel);
+        return;
+    }
+
+#ifdef _OPENMP
+    /* Every thread counts in its own replica, so no update is ever shared. */
+    const long long replicas_size = (long long)max_threads * count_size *
+                                    sizeof(int);
+    int *replicas = (int *)huge_alloc(replicas_size, false);
+    int num_threads = max_threads;
+
+    #pragma omp parallel num_threads(max_threads)
+    {
+        #pragma omp single
+        num_threads = omp_get_num_threads();
+
+        /* Each thread zeroes its own replica, so the pages are local to it. */
+        const int thread = omp_get_thread_num();
+        int *local_count = replicas + (long long)thread * count_size;
+        for (int i = 0; i < count_size; i++)
+            local_count[i] = 0;
+
+        /* Each thread counts a contiguous slice of the array. */
+        long long first = size * thread / num_threads;
+        long long last = size * (thread + 1) / num_threads;
+        count_with(array + first, last - first, min, local_count, count_size,
+                   kernel);
+        #pragma omp barrier
+
+        /* Sum the replicas, every thread taking care of a slice of count[]. */
+        #pragma omp for schedule(static)
+        for (int i = 0; i < count_size; i++) {
+            int sum = 0;
+            for (int t = 0; t < num_threads; t++)
+                sum += replicas[(long long)t * count_size + i];
+            count[i] += sum;
+        }
+    }
+
+    huge_free(replicas, replicas_size);
+#endif
+}
+
+
+void histogram_replicas_create(struct histogram_replicas *replicas,
+                               long long block_size, int min, int count_size,
+                               enum histogram_kernel kernel)
+{
+    replicas->kernel = choose_kernel(kernel, NULL, block_size, min,
+                                     count_size);
+    if (!histogram_kernel_supported(replicas->kernel))
+        replicas->kernel = KERNEL_SCALAR;
+    replicas->min = min;
+    replicas->count_size = count_size;
+
+#ifdef _OPENMP
+    int num_threads = omp_get_max_threads();
+    if (num_threads > block_size / THREAD_MIN_ELEMENTS)
+        num_threads = block_size / THREAD_MIN_ELEMENTS;
+#else
+    int num_threads = 1;
+#endif
+    replicas->num_threads = num_threads > 1 ? num_threads : 1;
+
+    const long long size = (long long)replicas->num_threads * count_size;
+    replicas->count = (int *)huge_alloc(size * sizeof(int), false);
+
+    /* Each thread zeroes its own replica, so the pages are local to it. */
+    #pragma omp parallel num_threads(replicas->num_threads)
+    {
+#ifdef _OPENMP
+        const int thread = omp_get_thread_num();
+#else
+        const int thread = 0;
+#endif
+        int *local_count = replicas->count + (long long)thread * count_size;
+        for (int i = 0; i < count_size; i++)
+            local_count[i] = 0;
+    }
+}
+
+
+void histogram_replicas_add(struct histogram_replicas *replicas,
+                            const int *array, long long size)
+{
+    #pragma omp parallel num_threads(replicas->num_threads)
+    {
+#ifdef _OPENMP
+        const int thread = omp_get_thread_num();
+        const int num_threads = omp_get_num_threads();
+#else
+        const int thread = 0;
+        const int num_threads = 1;
+#endif
+        /* Each thread counts a contiguous slice of the block. */
+        long long first = size * thread / num_threads;
+        long long last = size * (thread + 1) / num_threads;
+        count_with(array + first, last - first, replicas->min,
+                   replicas->count + (long long)thread * replicas->count_size,
+                   replicas->count_size, replicas->kernel);
+    }
+}
+
+
+void histogram_replicas_flush(struct histogram_replicas *replicas, int *count) {
+    const int count_size = replicas->count_size;
+    int *memory = replicas->count;
+
+    /* Every thread takes care of a slice of count[] and of every replica. */
+    #pragma omp parallel for num_threads(replicas->num_threads) \
+                             schedule(static)
+    for (int i = 0; i < count_size; i++) {
+        int sum = 0;
+        for (int t = 0; t < replicas->num_threads; t++) {
+            sum += memory[(long long)t * count_size + i];
+            memory[(long long)t * count_size + i] = 0;
+        }
+        count[i] += sum;
+    }
+}
+
+
+void histogram_replicas_free(struct histogram_replicas *replicas) {
+    huge_free(replicas->count, (long long)replicas->num_threads *
+                               replicas->count_size * sizeof(int));
+    replicas->count = NULL;
+}
+
+
+bool histogram_count_range(const int *array, long long size,
+                           long long max_count_size, int *min, int *max,
+                           int **count)
+{
+    *count = NULL;
+
+#ifdef _OPENMP
+    int max_threads = omp_get_max_threads();
+    if (max_threads > size / THREAD_MIN_ELEMENTS)
+        max_threads = size / THREAD_MIN_ELEMENTS;
+#else
+    int max_threads = 1;
+#endif
+    if (max_threads < 2) {
+        struct growing_histogram hist = {0, 0, NULL};
+        if (!count_growing(array, size, max_count_size, &hist, min, max))
+            return false;
+        if (hist.count != NULL)
+            *count = shrink_histogram(&hist, *min, *max);
+        return true;
+    }
+
+#ifdef _OPENMP
+    /*
+     * Every thread counts a contiguous slice of the array in its own histogram,
+     * whose range only covers the values of that slice.
+     */
+    struct growing_histogram *hists = (struct growing_histogram *)safe_alloc(
+        max_threads * sizeof(struct growing_histogram));
+    int *thread_min = (int *)safe_alloc(max_threads * sizeof(int));
+    int *thread_max = (int *)safe_alloc(max_threads * sizeof(int));
+    bool counted = true;
+    int num_threads = max_threads;
+
+    #pragma omp parallel num_threads(max_threads) reduction(&&: counted)
+    {
+        #pragma omp single
+        num_threads = omp_get_num_threads();
+
+        const int thread = omp_get_thread_num();
+        long long first = size * thread / num_threads;
+        long long last = size * (thread + 1) / num_threads;
+        hists[thread].count = NULL;
+        counted = count_growing(array + first, last - first, max_count_size,
+                                &hists[thread], &thread_min[thread],
+                                &thread_max[thread]);
+    }
+
+    *min = INT_MAX;
+    *max = INT_MIN;
+    for (int t = 0; t < num_threads; t++) {
+        if (thread_min[t] < *min)
+            *min = thread_min[t];
+        if (thread_max[t] > *max)
+            *max = thread_max[t];
+    }
+    const long long count_size = (long long)*max - *min + 1;
+    if (counted && count_size > max_count_size)
+        counted = false;
+
+    /* Sum the histograms, every thread taking care of a slice of count[]. */
+    if (counted) {
+        *count = (int *)safe_alloc(count_size * sizeof(int));
+        #pragma omp parallel for num_threads(num_threads) schedule(static)
+        for (long long i = 0; i < count_size; i++) {
+            const long long value = *min + i;
+            int sum = 0;
+            for (int t = 0; t < num_threads; t++)
+                if (value >= hists[t].min && value <= hists[t].max)
+                    sum += hists[t].count[value - hists[t].min];
+            (*count)[i] = sum;
+        }
+    }
+
+    for (int t = 0; t < num_threads; t++)
+        free(hists[t].count);
+    free(hists);
+    free(thread_min);
+    free(thread_max);
+    return counted;
+#endif
+}
@@ -25,30 +25,240 @@
  * along with this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <limits.h>
 #include <mpi.h>
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
+#include "affinity.h"
+#include "arena.h"
 #include "counting_sort.h"
+#include "partition.h"
+#include "planner.h"
 #include "util.h"
 
 
+/** @brief Number of chunks each portion is counted in with `--pipeline`. */
+#define PIPELINE_CHUNKS 8
+
+
+/** @brief Options given to the program as command line arguments. */
+struct program_options {
+    /** Whether each process holds only its own portion of the array. */
+    bool distributed;
+    /** Whether the array is held once for each node, in shared memory. */
+    bool shared;
+    /** Whether histograms are merged within each node first. */
+    bool hierarchical;
+    /** Whether histograms are merged within each NUMA domain first. */
+    bool numa;
+    /** Whether every thread is pinned to a CPU of its own. */
+    bool pin;
+    /** Whether the NUMA placement of the pages of the array is shown. */
+    bool numa_report;
+    /** Whether the portions follow the measured speed of each process. */
+    bool balance;
+    /** Whether the algorithm chosen, and why, is shown on standard error. */
+    bool explain;
+    /** If greater than 0, number of times the array is sorted with a plan. */
+    int repeat;
+    /** Whether the array is taken from an arena backed by huge pages. */
+    bool huge_pages;
+    /** Whether every page of the arena is touched before the array is used. */
+    bool prefault;
+    /** Whether the page faults taken are shown on standard error. */
+    bool faults;
+    /** Options tuning the sorting algorithm. */
+    struct sort_options sort;
+};
+
+
+/**
+ * @brief Read the options given as command line arguments.
+ * @param argc: Number of command line arguments.
+ * @param argv: Command line arguments; options start from the third one.
+ * @param opts: Options to fill (output).
+ * @return `true` if all the options are valid; `false` otherwise.
+ */
+static bool parse_options(int argc, char **argv,
+                          struct program_options *opts)
+{
+    opts->distributed = false;
+    opts->shared = false;
+    opts->hierarchical = false;
+    opts->numa = false;
+    opts->pin = false;
+    opts->numa_report = false;
+    opts->balance = false;
+    opts->explain = false;
+    opts->repeat = 0;
+    opts->huge_pages = false;
+    opts->prefault = false;
+    opts->faults = false;
+    sort_options_init(&opts->sort);
+
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "--distributed") == 0)
+            opts->distributed = true;
+        else if (strcmp(argv[i], "--shared") == 0)
+            opts->shared = true;
+        else if (strcmp(argv[i], "--hierarchical") == 0)
+            opts->hierarchical = true;
+        else if (strcmp(argv[i], "--numa") == 0)
+            opts->hierarchical = opts->numa = true;
+        else if (strcmp(argv[i], "--pin") == 0)
+            opts->pin = true;
+        else if (strcmp(argv[i], "--numa-report") == 0)
+            opts->numa_report = true;
+        else if (strcmp(argv[i], "--balance") == 0)
+            opts->balance = true;
+        else if (strcmp(argv[i], "--explain") == 0)
+            opts->explain = true;
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc) {
+            /* The number of executions must be a positive integer. */
+            char *end = NULL;
+            const long repeat = strtol(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || repeat <= 0 ||
+                repeat > INT_MAX)
+                return false;
+            opts->repeat = repeat;
+        }
+        else if (strcmp(argv[i], "--huge-pages") == 0)
+            opts->huge_pages = true;
+        else if (strcmp(argv[i], "--prefault") == 0)
+            opts->huge_pages = opts->prefault = true;
+        else if (strcmp(argv[i], "--faults") == 0)
+            opts->faults = true;
+        else if (strcmp(argv[i], "--local-expand") == 0)
+            opts->sort.expand = EXPAND_LOCAL;
+        else if (strcmp(argv[i], "--dense") == 0)
+            opts->sort.engine = ENGINE_DENSE;
+        else if (strcmp(argv[i], "--sparse") == 0)
+            opts->sort.engine = ENGINE_SPARSE;
+        else if (strcmp(argv[i], "--radix") == 0)
+            opts->sort.engine = ENGINE_RADIX;
+        else if (strcmp(argv[i], "--sample") == 0)
+            opts->sort.engine = ENGINE_SAMPLE;
+        else if (strcmp(argv[i], "--comparison") == 0)
+            opts->sort.engine = ENGINE_COMPARISON;
+        else if (strcmp(argv[i], "--single-pass") == 0)
+            opts->sort.single_pass = true;
+        else if (strcmp(argv[i], "--known-range") == 0)
+            opts->sort.range_known = true;
+        else if (strcmp(argv[i], "--pipeline") == 0)
+            opts->sort.pipeline_chunks = PIPELINE_CHUNKS;
+        else if (strcmp(argv[i], "--segmented") == 0)
+            opts->sort.segmented = true;
+        else
+            return false;
+    }
+    /*
+     * Plans only sort arrays stored in every process, counting them whole with
+     * the dense engine, merging the counts among all processes at once and
+     * gathering the sorted portions.
+     */
+    if (opts->repeat > 0 &&
+        (opts->distributed || opts->shared || opts->hierarchical ||
+         opts->sort.engine != ENGINE_AUTO || opts->sort.segmented ||
+         opts->sort.pipeline_chunks > 0 || opts->sort.single_pass ||
+         opts->sort.expand != EXPAND_GATHER))
+        return false;
+    /* The shared array lives in a window MPI allocates. */
+    if (opts->huge_pages && opts->shared)
+        return false;
+    return !(opts->distributed && opts->shared);
+}
+
+
+/**
+ * @brief Sort the array several times with the same plan, filling it with new
+ *        random integers before every execution.
+ * @param array:    The array.
+ * @param size:     Number of elements stored in the array.
+ * @param opts:     Options given to the program.
+ * @param num_proc: Number of MPI processes.
+ * @param rank:     Rank of the process calling the function.
+ * @return Average time taken by an execution, in seconds.
+ *
+ * The time of each execution is measured by the plan itself, so neither the
+ * initialization nor the creation of the plan are included.
+ */
+static double sort_with_plan(int *array, long long size,
+                             const struct program_options *opts, int num_proc,
+                             int rank)
+{
+    struct sort_plan plan;
+    sort_plan_create(&plan, array, size, RANGE_MIN, RANGE_MAX, &opts->sort,
+                     MPI_COMM_WORLD);
+
+    double min_time = 0, max_time = 0;
+    for (int i = 0; i < opts->repeat; i++) {
+        if (i > 0)
+            array_init_random(array, size, RANGE_MIN, RANGE_MAX, num_proc,
+                              rank);
+        double time = sort_plan_execute(&plan);
+        if (i == 0 || time < min_time)
+            min_time = time;
+        if (time > max_time)
+            max_time = time;
+    }
+
+    const double mean_time = plan.total_time / plan.executions;
+    if (rank == 0)
+        fprintf(stderr, "executions=%lld mean=%.6f min=%.6f max=%.6f\n",
+                plan.executions, mean_time, min_time, max_time);
+    sort_plan_free(&plan);
+    return mean_time;
+}
+
+
+
 int main(int argc, char **argv) {
-    MPI_Init(&argc, &argv);
+    /* OpenMP threads never call MPI: only the main thread does. */
+    int thread_support;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
     int rank;
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     int num_proc;
     MPI_Comm_size(MPI_COMM_WORLD, &num_proc);
 
-    /* Check for the correct amount of command line arguments. */
-    if (argc != 2) {
+    /* Check for the correct command line arguments. */
+    struct program_options opts;
+    if (argc < 2 || !parse_options(argc, argv, &opts)) {
         if (rank == 0)
-            fprintf(stderr, "ERROR! usage: bin/parallel.out array_size\n");
+            fprintf(stderr, "ERROR! usage: bin/parallel.out array_size "
+                            "[--distributed | --shared] [--local-expand] "
+                            "[--dense | --sparse | --radix | --sample | "
+                            "--comparison] "
+                            "[--single-pass] [--known-range] "
+                            "[--pipeline] [--segmented] [--hierarchical] "
+                            "[--balance] [--explain] [--repeat N] "
+                            "[--huge-pages] [--prefault] [--faults] "
+                            "[--numa] [--pin] [--numa-report]\n");
         MPI_Barrier(MPI_COMM_WORLD);
         MPI_Finalize();
         exit(EXIT_FAILURE);
     }
 
+    /* Threads are pinned before they first touch any page. */
+    if (opts.pin && !affinity_pin(rank))
+        fprintf(stderr, "WARNING! could not pin the threads of process %d.\n",
+                rank);
+
+    /* Processes are grouped by the node, or NUMA domain, they run on. */
+    struct topology topology;
+    if (opts.hierarchical) {
+        topology_create(&topology, opts.numa ? TOPOLOGY_NUMA : 0, num_proc,
+                        rank);
+        opts.sort.topology = &topology;
+    }
+
+    /* Slower processes are given smaller portions of every array. */
+    if (opts.balance)
+        partition_measure_weights(num_proc, rank);
+
     /* Check for the correctness of the range. */
     if (RANGE_MAX <= RANGE_MIN) {
         if (rank == 0)
@@ -58,29 +268,139 @@ int main(int argc, char **argv) {
         exit(EXIT_FAILURE);
     }
 
-    /* Create the array with size given as command line argument. */
+    /*
+     * Create the array with size given as command line argument. In
+     * distributed mode, each process only allocates its own portion; in shared
+     * mode, the array is allocated once for each node.
+     */
     const long long size = atoll(argv[1]);
-    int *array = (int *)safe_alloc(size * sizeof(int));
+    long long local_offset = 0, local_size = size;
+    if (opts.distributed || opts.shared)
+        array_block(size, num_proc, rank, &local_offset, &local_size);
+    struct node_array node_array;
+    struct arena arena;
+    int *array = NULL;
+    if (opts.shared) {
+        node_array_alloc(&node_array, size, 0, num_proc, rank);
+        array = node_array.data;
+    }
+    else if (opts.huge_pages) {
+        arena_create(&arena, local_size * sizeof(int), opts.prefault);
+        array = (int *)arena_alloc(&arena, local_size * sizeof(int));
+    }
+    else {
+        /* A process could own no elements, but allocations can not be empty. */
+        array = (int *)safe_alloc((local_size > 0 ? local_size : 1) *
+                                  sizeof(int));
+    }
 
     /* To store execution time measurements. */
     double time_init = 0, time_sort = 0, time_elapsed = 0;
 
+    /* Minor and major faults taken by the initialization and by the sort. */
+    struct page_faults faults_start, faults_init, faults_sort;
+    page_faults_read(&faults_start);
+
     /*
      * Initialize the array by filling it with integers, either generated
      * randomly or taken from a file.
      */
     START_TIME(time_init);
-    array_init_random(array, size, RANGE_MIN, RANGE_MAX, num_proc, rank);
-    // array_init_from_file(array, size, INPUT_FILE_PATH, num_proc, rank);
+    if (opts.shared)
+        array_init_random_local(array + local_offset, local_size, RANGE_MIN,
+                                RANGE_MAX, rank);
+    else if (opts.distributed) {
+        array_init_random_local(array, local_size, RANGE_MIN, RANGE_MAX, rank);
+        // array_init_from_file_local(array, local_size, local_offset,
+        //                            INPUT_FILE_PATH);
+    }
+    else {
+        array_init_random(array, size, RANGE_MIN, RANGE_MAX, num_proc, rank);
+        // array_init_from_file(array, size, INPUT_FILE_PATH, num_proc, rank);
+    }
     END_TIME(time_init);
+    page_faults_read(&faults_init);
+
+    /* Pages of the portion each process counts, summed over all processes. */
+    long long pages[3] = {0, 0, 0};
+    if (opts.numa_report) {
+        long long count_offset = local_offset, count_size = local_size;
+        if (!opts.distributed && !opts.shared)
+            array_block(size, num_proc, rank, &count_offset, &count_size);
+        if (opts.distributed)
+            count_offset = 0;
+        struct numa_balance balance;
+        numa_balance_measure(array + count_offset, count_size * sizeof(int),
+                             &balance);
+        pages[0] = balance.local;
+        pages[1] = balance.remote;
+        pages[2] = balance.unknown;
+        MPI_Reduce(rank == 0 ? MPI_IN_PLACE : pages, pages, 3, MPI_LONG_LONG,
+                   MPI_SUM, 0, MPI_COMM_WORLD);
+    }
+
+    struct sort_decision decision;
+    opts.sort.decision = &decision;
 
-    /* Sort the array. */
-    START_TIME(time_sort);
-    counting_sort(array, size, num_proc, rank);
-    END_TIME(time_sort);
+    /* Sort the array; with a plan, the average time of an execution counts. */
+    if (opts.repeat > 0) {
+        decision.engine = ENGINE_DENSE;
+        decision.sample_size = 0;
+        time_sort = sort_with_plan(array, size, &opts, num_proc, rank);
+    }
+    else {
+        START_TIME(time_sort);
+        if (opts.shared)
+            counting_sort_shared(&node_array, size, &opts.sort, num_proc,
+                                 rank);
+        else if (opts.distributed)
+            counting_sort_dist(array, local_size, &opts.sort, num_proc, rank);
+        else
+            counting_sort_opts(array, size, &opts.sort, num_proc, rank);
+        END_TIME(time_sort);
+    }
+    page_faults_read(&faults_sort);
+
+    /* Faults are summed over all processes. */
+    long long faults[4] = {faults_init.minor - faults_start.minor,
+                           faults_init.major - faults_start.major,
+                           faults_sort.minor - faults_init.minor,
+                           faults_sort.major - faults_init.major};
+    if (opts.faults)
+        MPI_Reduce(rank == 0 ? MPI_IN_PLACE : faults, faults, 4, MPI_LONG_LONG,
+                   MPI_SUM, 0, MPI_COMM_WORLD);
 
+    /* The shared memory has to be released while MPI is still running. */
+    if (opts.shared)
+        node_array_free(&node_array);
+    else if (opts.huge_pages)
+        arena_destroy(&arena);
+    else
+        free(array);
+    if (opts.hierarchical)
+        topology_free(&topology);
     MPI_Finalize();
-    free(array);
+
+    /* The decision goes to standard error, not to mix it with the results. */
+    if (rank == 0 && opts.explain) {
+        fprintf(stderr, "engine=%s", sort_engine_name(decision.engine));
+        if (decision.sample_size > 0) {
+            fprintf(stderr, " sample=%lld range=%lld distinct=%lld skew=%.3f "
+                            "sortedness=%.3f", decision.sample_size,
+                    decision.range, decision.distinct, decision.skew,
+                    decision.sortedness);
+            for (int i = ENGINE_DENSE; i < NUM_ENGINES; i++)
+                fprintf(stderr, " cost_%s=%.0f", sort_engine_name(i),
+                        decision.cost[i]);
+        }
+        fprintf(stderr, "\n");
+    }
+    if (rank == 0 && opts.numa_report)
+        fprintf(stderr, "numa_local=%lld numa_remote=%lld numa_unknown=%lld\n",
+                pages[0], pages[1], pages[2]);
+    if (rank == 0 && opts.faults)
+        fprintf(stderr, "faults_init=%lld/%lld faults_sort=%lld/%lld\n",
+                faults[0], faults[1], faults[2], faults[3]);
 
     if (rank == 0) {
         /* Only consider the initialization and sorting times. */
@@ -0,0 +1,134 @@
+/**
+ * @file node_array.c
+ * @brief This file contains an array allocated once for each node, in memory
+ *        shared by all the MPI processes running on it.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "node_array.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+
+#include "partition.h"
+#include "util.h"
+
+
+
+void node_array_alloc(struct node_array *array, long long size,
+                      int ranks_per_node, int num_proc, int rank)
+{
+    topology_create(&array->topology, ranks_per_node, num_proc, rank);
+    const bool leader = array->topology.leader_comm != MPI_COMM_NULL;
+
+    /*
+     * The whole array is allocated by the first process of the node; every
+     * process then asks where that memory is mapped in its own address space.
+     */
+    int *base = NULL;
+    MPI_Aint bytes = leader ? size * sizeof(int) : 0;
+    MPI_Win_allocate_shared(bytes, sizeof(int), MPI_INFO_NULL,
+                            array->topology.node_comm, &base, &array->win);
+    int disp_unit;
+    MPI_Win_shared_query(array->win, 0, &bytes, &disp_unit, &array->data);
+
+    /* Accesses are synchronised by node_array_sync() from now on. */
+    MPI_Win_lock_all(MPI_MODE_NOCHECK, array->win);
+}
+
+
+void node_array_free(struct node_array *array) {
+    MPI_Win_unlock_all(array->win);
+    MPI_Win_free(&array->win);
+    topology_free(&array->topology);
+    array->data = NULL;
+}
+
+
+void node_array_sync(const struct node_array *array) {
+    MPI_Win_sync(array->win);
+    MPI_Barrier(array->topology.node_comm);
+    MPI_Win_sync(array->win);
+}
+
+
+void node_array_gather(struct node_array *array, long long size,
+                       int num_proc)
+{
+    /* Leaders read the portions written by the other processes of the node. */
+    node_array_sync(array);
+
+    const struct topology *topo = &array->topology;
+    if (topo->leader_comm != MPI_COMM_NULL && topo->num_nodes > 1) {
+        /*
+         * Each block of the datatype holds at most #LARGE_COUNT_CHUNK elements,
+         * so that its int length does not overflow on longer portions.
+         */
+        long long max_blocks = 0;
+        for (int i = 0; i < num_proc; i++) {
+            long long offset_i = 0, size_i = 0;
+            array_block(size, num_proc, i, &offset_i, &size_i);
+            max_blocks += (size_i + LARGE_COUNT_CHUNK - 1) / LARGE_COUNT_CHUNK;
+        }
+        if (max_blocks == 0)
+            max_blocks = 1;
+        int *lengths = (int *)safe_alloc(max_blocks * sizeof(int));
+        MPI_Aint *displs = (MPI_Aint *)safe_alloc(max_blocks *
+                                                  sizeof(MPI_Aint));
+
+        /*
+         * The processes of a node need not have consecutive ranks, so the
+         * portions of each node are described by an indexed datatype, the same
+         * in every leader, and broadcast by the leader of that node.
+         */
+        for (int node = 0; node < topo->num_nodes; node++) {
+            int blocks = 0;
+            for (int i = 0; i < num_proc; i++) {
+                if (topo->node_of[i] != node)
+                    continue;
+                long long offset_i = 0, size_i = 0;
+                array_block(size, num_proc, i, &offset_i, &size_i);
+                for (long long k = 0; k < size_i; k += LARGE_COUNT_CHUNK) {
+                    lengths[blocks] = size_i - k < LARGE_COUNT_CHUNK
+                                      ? size_i - k : LARGE_COUNT_CHUNK;
+                    displs[blocks] = (offset_i + k) * sizeof(int);
+                    blocks++;
+                }
+            }
+
+            MPI_Datatype portions;
+            /* Offsets in bytes do not overflow beyond 2^31 elements. */
+            MPI_Type_create_hindexed(blocks, lengths, displs, MPI_INT,
+                                     &portions);
+            MPI_Type_commit(&portions);
+            MPI_Bcast(array->data, 1, portions, node, topo->leader_comm);
+            MPI_Type_free(&portions);
+        }
+
+        free(lengths);
+        free(displs);
+    }
+
+    /* The other processes read what their leader has received. */
+    node_array_sync(array);
+}
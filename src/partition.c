@@ -0,0 +1,326 @@
+/**
+ * @file partition.c
+ * @brief This file contains the partitioning of arrays among the MPI
+ *        processes, shared by the initialization and sorting functions.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "partition.h"
+
+#include <mpi.h>
+#include <stdlib.h>
+
+#include "histogram.h"
+#include "util.h"
+
+/** @brief Number of elements each process counts to measure its speed. */
+#define CALIBRATION_SIZE (1 << 22)
+
+/** @brief Number of times the counting is timed; the best time is kept. */
+#define CALIBRATION_REPEATS 3
+
+/** @brief Tag of the chunks exchanged by array_alltoallv(). */
+#define TAG_LARGE_COUNT 4
+
+
+/**
+ * @brief Weight of every process, summed up to each rank: the portion of
+ *        process `i` spans the fraction [cumulative[i]; cumulative[i + 1]) of
+ *        the array. `NULL` if all processes have the same weight.
+ */
+static double *cumulative = NULL;
+
+/** @brief Number of processes the weights were set for. */
+static int cumulative_size = 0;
+
+
+/**
+ * @brief Find where the portion of a process starts.
+ * @param size:     Number of elements in the whole array.
+ * @param num_proc: Number of MPI processes.
+ * @param rank:     Rank of the process, up to `num_proc` for the end of the
+ *                  array.
+ * @return Position of the first element of the portion.
+ */
+static long long block_start(long long size, int num_proc, int rank) {
+    if (rank >= num_proc)
+        return size;
+    if (cumulative == NULL || cumulative_size != num_proc)
+        /* floor(size * rank / num_proc): sizes differ by one at most. */
+        return size / num_proc * rank + size % num_proc * rank / num_proc;
+    return (long long)(size * cumulative[rank]);
+}
+
+
+/**
+ * @brief Broadcast a buffer in chunks of at most #LARGE_COUNT_CHUNK elements.
+ * @param buffer: The buffer.
+ * @param type:   Type of the elements of the buffer.
+ * @param count:  Number of elements in the buffer.
+ * @param root:   Rank of the process whose buffer is broadcast.
+ */
+static void bcast_chunks(void *buffer, MPI_Datatype type, long long count,
+                         int root)
+{
+    MPI_Aint lower_bound, extent;
+    MPI_Type_get_extent(type, &lower_bound, &extent);
+    for (long long first = 0; first < count; first += LARGE_COUNT_CHUNK) {
+        long long chunk = count - first < LARGE_COUNT_CHUNK
+                          ? count - first : LARGE_COUNT_CHUNK;
+        MPI_Bcast((char *)buffer + first * extent, chunk, type, root,
+                  MPI_COMM_WORLD);
+    }
+}
+
+
+/**
+ * @brief Collect the portions of an array too long for `int` counts into the
+ *        array of every process.
+ * @param array:    The array, as in array_gather().
+ * @param type:     Type of the elements of the array.
+ * @param size:     Number of elements stored in the array.
+ * @param num_proc: Number of MPI processes.
+ */
+static void gather_large(void *array, MPI_Datatype type, long long size,
+                         int num_proc)
+{
+#if MPI_VERSION >= 4
+    MPI_Count *recv_counts = (MPI_Count *)safe_alloc(num_proc *
+                                                     sizeof(MPI_Count));
+    MPI_Aint *displs = (MPI_Aint *)safe_alloc(num_proc * sizeof(MPI_Aint));
+    for (int i = 0; i < num_proc; i++) {
+        long long offset_i = 0, size_i = 0;
+        array_block(size, num_proc, i, &offset_i, &size_i);
+        recv_counts[i] = size_i;
+        displs[i] = offset_i;
+    }
+
+    MPI_Allgatherv_c(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, array, recv_counts,
+                     displs, type, MPI_COMM_WORLD);
+
+    free(recv_counts);
+    free(displs);
+#else
+    /* Each process broadcasts its own portion, a chunk at a time. */
+    MPI_Aint lower_bound, extent;
+    MPI_Type_get_extent(type, &lower_bound, &extent);
+    for (int i = 0; i < num_proc; i++) {
+        long long offset_i = 0, size_i = 0;
+        array_block(size, num_proc, i, &offset_i, &size_i);
+        bcast_chunks((char *)array + offset_i * extent, type, size_i, i);
+    }
+#endif
+}
+
+
+/**
+ * @brief Exchange blocks of elements among all processes, as
+ *        array_alltoallv(), when some count or position does not fit in an
+ *        `int`.
+ * @param send:        Elements to send.
+ * @param send_counts: Number of elements sent to each process.
+ * @param send_displs: Position in `send` of the elements sent to each process.
+ * @param recv:        Where to store the elements received (output).
+ * @param recv_counts: Number of elements received from each process.
+ * @param recv_displs: Position in `recv` of the elements received from each
+ *                     process.
+ * @param type:        Type of the elements.
+ * @param num_proc:    Number of MPI processes.
+ */
+static void alltoallv_large(const void *send, const long long *send_counts,
+                            const long long *send_displs, void *recv,
+                            const long long *recv_counts,
+                            const long long *recv_displs, MPI_Datatype type,
+                            int num_proc)
+{
+#if MPI_VERSION >= 4
+    MPI_Count *counts = (MPI_Count *)safe_alloc(2 * num_proc *
+                                                sizeof(MPI_Count));
+    MPI_Aint *displs = (MPI_Aint *)safe_alloc(2 * num_proc * sizeof(MPI_Aint));
+    for (int i = 0; i < num_proc; i++) {
+        counts[i] = send_counts[i];
+        displs[i] = send_displs[i];
+        counts[num_proc + i] = recv_counts[i];
+        displs[num_proc + i] = recv_displs[i];
+    }
+
+    MPI_Alltoallv_c(send, counts, displs, type, recv, counts + num_proc,
+                    displs + num_proc, type, MPI_COMM_WORLD);
+
+    free(counts);
+    free(displs);
+#else
+    MPI_Aint lower_bound, extent;
+    MPI_Type_get_extent(type, &lower_bound, &extent);
+
+    /* One request for each chunk sent or received. */
+    long long num_requests = 0;
+    for (int i = 0; i < num_proc; i++)
+        num_requests += (send_counts[i] + LARGE_COUNT_CHUNK - 1) /
+                        LARGE_COUNT_CHUNK +
+                        (recv_counts[i] + LARGE_COUNT_CHUNK - 1) /
+                        LARGE_COUNT_CHUNK;
+    MPI_Request *requests = (MPI_Request *)safe_alloc(
+        (num_requests > 0 ? num_requests : 1) * sizeof(MPI_Request));
+
+    /* Chunks between two processes arrive in the order they are sent. */
+    long long r = 0;
+    for (int i = 0; i < num_proc; i++)
+        for (long long k = 0; k < recv_counts[i]; k += LARGE_COUNT_CHUNK) {
+            long long chunk = recv_counts[i] - k < LARGE_COUNT_CHUNK
+                              ? recv_counts[i] - k : LARGE_COUNT_CHUNK;
+            MPI_Irecv((char *)recv + (recv_displs[i] + k) * extent, chunk,
+                      type, i, TAG_LARGE_COUNT, MPI_COMM_WORLD,
+                      &requests[r++]);
+        }
+    for (int i = 0; i < num_proc; i++)
+        for (long long k = 0; k < send_counts[i]; k += LARGE_COUNT_CHUNK) {
+            long long chunk = send_counts[i] - k < LARGE_COUNT_CHUNK
+                              ? send_counts[i] - k : LARGE_COUNT_CHUNK;
+            MPI_Isend((const char *)send + (send_displs[i] + k) * extent,
+                      chunk, type, i, TAG_LARGE_COUNT, MPI_COMM_WORLD,
+                      &requests[r++]);
+        }
+    MPI_Waitall(r, requests, MPI_STATUSES_IGNORE);
+
+    free(requests);
+#endif
+}
+
+
+
+void array_block(long long size, int num_proc, int rank, long long *offset,
+                 long long *local_size)
+{
+    *offset = block_start(size, num_proc, rank);
+    *local_size = block_start(size, num_proc, rank + 1) - *offset;
+}
+
+
+void array_gather(void *array, MPI_Datatype type, long long size,
+                  int num_proc)
+{
+    if (size > LARGE_COUNT_CHUNK) {
+        gather_large(array, type, size, num_proc);
+        return;
+    }
+
+    int *recv_counts = (int *)safe_alloc(num_proc * sizeof(int));
+    int *displs = (int *)safe_alloc(num_proc * sizeof(int));
+    for (int i = 0; i < num_proc; i++) {
+        long long offset_i = 0, size_i = 0;
+        array_block(size, num_proc, i, &offset_i, &size_i);
+        recv_counts[i] = size_i;
+        displs[i] = offset_i;
+    }
+
+    MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, array, recv_counts,
+                   displs, type, MPI_COMM_WORLD);
+
+    free(recv_counts);
+    free(displs);
+}
+
+
+
+void array_alltoallv(const void *send, const long long *send_counts,
+                     const long long *send_displs, void *recv,
+                     const long long *recv_counts,
+                     const long long *recv_displs, MPI_Datatype type,
+                     int num_proc)
+{
+    /* All processes have to take the same way. */
+    int large = 0;
+    for (int i = 0; i < num_proc; i++)
+        if (send_counts[i] + send_displs[i] > LARGE_COUNT_CHUNK ||
+            recv_counts[i] + recv_displs[i] > LARGE_COUNT_CHUNK)
+            large = 1;
+    MPI_Allreduce(MPI_IN_PLACE, &large, 1, MPI_INT, MPI_MAX, MPI_COMM_WORLD);
+
+    if (!large) {
+        int *counts = (int *)safe_alloc(4 * num_proc * sizeof(int));
+        for (int i = 0; i < num_proc; i++) {
+            counts[i] = send_counts[i];
+            counts[num_proc + i] = send_displs[i];
+            counts[2 * num_proc + i] = recv_counts[i];
+            counts[3 * num_proc + i] = recv_displs[i];
+        }
+        MPI_Alltoallv(send, counts, counts + num_proc, type, recv,
+                      counts + 2 * num_proc, counts + 3 * num_proc, type,
+                      MPI_COMM_WORLD);
+        free(counts);
+        return;
+    }
+
+    alltoallv_large(send, send_counts, send_displs, recv, recv_counts,
+                    recv_displs, type, num_proc);
+}
+
+
+void partition_set_weights(const double *weights, int num_proc) {
+    free(cumulative);
+    cumulative = NULL;
+    cumulative_size = 0;
+    if (weights == NULL)
+        return;
+
+    double total = 0;
+    for (int i = 0; i < num_proc; i++)
+        total += weights[i];
+
+    cumulative = (double *)safe_alloc(num_proc * sizeof(double));
+    cumulative_size = num_proc;
+    double sum = 0;
+    for (int i = 0; i < num_proc; i++) {
+        cumulative[i] = sum / total;
+        sum += weights[i];
+    }
+}
+
+
+void partition_measure_weights(int num_proc, int rank) {
+    int *array = (int *)safe_alloc(CALIBRATION_SIZE * sizeof(int));
+    int *count = (int *)safe_alloc((RANGE_MAX - RANGE_MIN + 1) * sizeof(int));
+    array_init_random_local(array, CALIBRATION_SIZE, RANGE_MIN, RANGE_MAX,
+                            rank);
+
+    double best = 0;
+    for (int i = 0; i < CALIBRATION_REPEATS; i++) {
+        double start = MPI_Wtime();
+        histogram_count(array, CALIBRATION_SIZE, RANGE_MIN, count,
+                        RANGE_MAX - RANGE_MIN + 1, KERNEL_AUTO);
+        double time = MPI_Wtime() - start;
+        if (i == 0 || time < best)
+            best = time;
+    }
+    free(array);
+    free(count);
+
+    /* Processes twice as fast get twice as many elements. */
+    double speed = best > 0 ? 1 / best : 1;
+    double *weights = (double *)safe_alloc(num_proc * sizeof(double));
+    MPI_Allgather(&speed, 1, MPI_DOUBLE, weights, 1, MPI_DOUBLE,
+                  MPI_COMM_WORLD);
+    partition_set_weights(weights, num_proc);
+    free(weights);
+}
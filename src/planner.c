@@ -0,0 +1,286 @@
+/**
+ * @file planner.c
+ * @brief This file contains the planner choosing the algorithm to sort an
+ *        array with, from a sample of its elements.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "planner.h"
+
+#include <limits.h>
+#include <math.h>
+#include <mpi.h>
+#include <stdlib.h>
+
+#include "util.h"
+
+/** @brief Number of elements each process samples from its portion. */
+#define SAMPLE_PER_PROCESS 256
+
+/**
+ * @brief Largest distributed array the comparison sort is chosen for, since it
+ *        collects the whole array in every process.
+ */
+#define COMPARISON_MAX_DIST (1 << 16)
+
+/*
+ * Costs are given in units of the time needed to count one element, so that
+ * only their ratios matter.
+ */
+
+/** @brief Cost of each round of messages of a collective operation. */
+#define COST_MESSAGE 5000.0
+
+/** @brief Cost of receiving one integer from another process. */
+#define COST_WORD 1.0
+
+/** @brief Cost of counting one element in the hash table of #ENGINE_SPARSE. */
+#define COST_HASH 4.0
+
+/** @brief Cost of one comparison of the comparison sort. */
+#define COST_COMPARE 2.0
+
+
+/**
+ * @brief Sample a distributed array and estimate its number of distinct values,
+ *        skew and sortedness.
+ * @param local_array: Portion of the array owned by the calling process.
+ * @param local_size:  Number of elements in the portion.
+ * @param size:        Number of elements in the whole array, greater than 0.
+ * @param num_proc:    Number of MPI processes.
+ * @param decision:    Where to store the figures found (output); its `range`
+ *                     has to be already set.
+ */
+static void sample_array(const int *local_array, long long local_size,
+                         long long size, int num_proc,
+                         struct sort_decision *decision)
+{
+    const int local_sample = local_size < SAMPLE_PER_PROCESS
+                             ? local_size : SAMPLE_PER_PROCESS;
+    int *local_values = (int *)safe_alloc((local_sample > 0 ? local_sample : 1)
+                                          * sizeof(int));
+
+    /*
+     * Number of elements sampled, of those in order with the next element and
+     * of those having a next element in the portion.
+     */
+    int figures[3] = {local_sample, 0, 0};
+    for (int i = 0; i < local_sample; i++) {
+        const long long pos = i * local_size / local_sample;
+        local_values[i] = local_array[pos];
+        if (pos + 1 < local_size) {
+            figures[1] += local_array[pos] <= local_array[pos + 1];
+            figures[2]++;
+        }
+    }
+
+    int *all_figures = (int *)safe_alloc(3 * num_proc * sizeof(int));
+    MPI_Allgather(figures, 3, MPI_INT, all_figures, 3, MPI_INT,
+                  MPI_COMM_WORLD);
+    int *counts = (int *)safe_alloc(num_proc * sizeof(int));
+    int *displs = (int *)safe_alloc(num_proc * sizeof(int));
+    long long sample_size = 0, in_order = 0, pairs = 0;
+    for (int i = 0; i < num_proc; i++) {
+        counts[i] = all_figures[3 * i];
+        displs[i] = sample_size;
+        sample_size += all_figures[3 * i];
+        in_order += all_figures[3 * i + 1];
+        pairs += all_figures[3 * i + 2];
+    }
+
+    int *sample = (int *)safe_alloc(sample_size * sizeof(int));
+    MPI_Allgatherv(local_values, local_sample, MPI_INT, sample, counts, displs,
+                   MPI_INT, MPI_COMM_WORLD);
+    qsort(sample, sample_size, sizeof(int), compare_ints);
+
+    /* Values met in the sample, values met only once and the most frequent. */
+    long long seen = 0, once = 0, largest = 0;
+    for (long long i = 0, j = 0; i < sample_size; i = j) {
+        while (j < sample_size && sample[j] == sample[i])
+            j++;
+        seen++;
+        once += j - i == 1;
+        if (j - i > largest)
+            largest = j - i;
+    }
+
+    /*
+     * Values met more than once are frequent in the whole array as well, while
+     * each value met once may stand for many others never sampled: up to
+     * sqrt(size / sample_size) of them, as in the Guaranteed-Error Estimator.
+     */
+    double distinct = sqrt((double)size / sample_size) * once + (seen - once);
+    const double most = size < decision->range ? size : decision->range;
+    if (distinct > most)
+        distinct = most;
+
+    decision->sample_size = sample_size;
+    decision->distinct = distinct;
+    decision->skew = (double)largest / sample_size;
+    decision->sortedness = pairs > 0 ? (double)in_order / pairs : 1;
+
+    free(local_values);
+    free(all_figures);
+    free(counts);
+    free(displs);
+    free(sample);
+}
+
+
+/**
+ * @brief Estimate the cost of each algorithm from the figures of the array.
+ * @param size:       Number of elements in the whole array.
+ * @param radix_bits: Number of bits in each digit of #ENGINE_RADIX.
+ * @param replicated: Whether the sorted portions have to be collected by every
+ *                    process.
+ * @param num_proc:   Number of MPI processes.
+ * @param decision:   Figures of the array (input) and cost of each algorithm
+ *                    (output).
+ */
+static void estimate_costs(long long size, int radix_bits, bool replicated,
+                           int num_proc, struct sort_decision *decision)
+{
+    const double n = size;
+    const double portion = ceil(n / num_proc);
+    const double range = decision->range;
+    const double distinct = decision->distinct;
+    const double local_distinct = distinct < portion ? distinct : portion;
+
+    /* Rounds of messages of a collective operation, as in a binary tree. */
+    const double rounds = ceil(log2(num_proc));
+    /* Collecting the whole array in every process. */
+    const double gather = num_proc > 1 ? n * COST_WORD + rounds * COST_MESSAGE
+                                       : 0;
+    const double collect = replicated ? gather : 0;
+
+    double *cost = decision->cost;
+    cost[ENGINE_AUTO] = HUGE_VAL;
+
+    /* Count and expand the portion; clear, reduce and scan count[]. */
+    cost[ENGINE_DENSE] = HUGE_VAL;
+    if (range <= INT_MAX)
+        cost[ENGINE_DENSE] = 2 * portion + range +
+                             rounds * (COST_MESSAGE + range * COST_WORD) +
+                             collect;
+
+    /*
+     * Count the portion in the hash table and sort its values; merge the
+     * values of all processes along a tree, then broadcast them; expand.
+     */
+    cost[ENGINE_SPARSE] = portion * COST_HASH +
+                          local_distinct * log2(local_distinct + 1) *
+                          COST_COMPARE +
+                          rounds * (2 * COST_MESSAGE +
+                                    4 * distinct * COST_WORD + 2 * distinct) +
+                          portion + collect;
+
+    /*
+     * For each digit: count it and scatter the portion by it twice; reduce
+     * and scan the counts of the digits; send the portion to its new owners.
+     */
+    const unsigned long long span = decision->range - 1;
+    int bits = 1;
+    while ((span >> bits) != 0)
+        bits++;
+    const int passes = (bits + radix_bits - 1) / radix_bits;
+    const double digits = 1 << radix_bits;
+    cost[ENGINE_RADIX] = passes * (3 * portion + digits +
+                                   rounds * (4 * COST_MESSAGE +
+                                             4 * digits * COST_WORD) +
+                                   (num_proc > 1 ? portion * COST_WORD : 0)) +
+                         collect;
+
+    /*
+     * Sort the portion and merge what arrives from every process, sending it
+     * twice: to the process of its bucket, then to the owner of its position.
+     * Only the samples, `num_proc - 1` from each process, are collected.
+     */
+    cost[ENGINE_SAMPLE] = portion * log2(portion + 1) * COST_COMPARE +
+                          rounds * (COST_MESSAGE +
+                                    2 * num_proc * num_proc * COST_WORD) +
+                          portion * rounds +
+                          2 * (num_proc > 1 ? portion * COST_WORD : 0) +
+                          4 * rounds * COST_MESSAGE + collect;
+
+    /*
+     * Collect the whole array and sort it: merging sorted runs takes about
+     * half the comparisons.
+     */
+    cost[ENGINE_COMPARISON] = HUGE_VAL;
+    if (replicated || size <= COMPARISON_MAX_DIST)
+        cost[ENGINE_COMPARISON] = gather + n * log2(n) * COST_COMPARE *
+                                  (1 - decision->sortedness / 2);
+}
+
+
+
+void plan_engine(const int *local_array, long long local_size, long long size,
+                 int min, int max, enum sort_engine engine, int radix_bits,
+                 bool replicated, int num_proc,
+                 struct sort_decision *decision)
+{
+    decision->engine = engine;
+    decision->sample_size = 0;
+    decision->range = (long long)max - min + 1;
+    decision->distinct = 0;
+    decision->skew = 0;
+    decision->sortedness = 0;
+    for (int i = 0; i < NUM_ENGINES; i++)
+        decision->cost[i] = 0;
+
+    if (engine != ENGINE_AUTO)
+        return;
+    /* An empty array has no range: nothing would be counted anyway. */
+    if (size == 0) {
+        decision->engine = ENGINE_COMPARISON;
+        return;
+    }
+
+    sample_array(local_array, local_size, size, num_proc, decision);
+    estimate_costs(size, radix_bits, replicated, num_proc, decision);
+
+    /* Every process has the same sample, so it takes the same decision. */
+    decision->engine = ENGINE_DENSE;
+    for (int i = ENGINE_DENSE; i < NUM_ENGINES; i++)
+        if (decision->cost[i] < decision->cost[decision->engine])
+            decision->engine = i;
+}
+
+
+const char *sort_engine_name(enum sort_engine engine) {
+    switch (engine) {
+        case ENGINE_DENSE:
+            return "dense";
+        case ENGINE_SPARSE:
+            return "sparse";
+        case ENGINE_RADIX:
+            return "radix";
+        case ENGINE_SAMPLE:
+            return "sample";
+        case ENGINE_COMPARISON:
+            return "comparison";
+        default:
+            return "auto";
+    }
+}
@@ -0,0 +1,299 @@
+/**
+ * @file radix_sort.c
+ * @brief This file contains an implementation of the LSD Radix Sort Algorithm
+ *        for distributed arrays, made of one Counting Sort pass for each digit
+ *        of the values.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "radix_sort.h"
+
+#include <mpi.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "partition.h"
+#include "util.h"
+
+
+/**
+ * @brief Count the occurrences of each digit among the keys.
+ * @param keys:  The keys.
+ * @param size:  Number of keys.
+ * @param shift: Position of the lowest bit of the digit.
+ * @param mask:  Mask selecting the bits of the digit, once shifted.
+ * @param count: Number of occurrences of each digit (output); it must have
+ *               `mask + 1` items.
+ */
+static void count_digits(const unsigned *keys, long long size, int shift,
+                         unsigned mask, long long *count)
+{
+    for (unsigned i = 0; i <= mask; i++)
+        count[i] = 0;
+    for (long long i = 0; i < size; i++)
+        count[(keys[i] >> shift) & mask] += 1;
+}
+
+
+/**
+ * @brief Stably scatter the keys, and their payloads, by one of their digits.
+ * @param portion: The keys, scattered into its temporary buffers.
+ * @param shift:   Position of the lowest bit of the digit.
+ * @param mask:    Mask selecting the bits of the digit, once shifted.
+ * @param count:   Number of occurrences of each digit among the keys; it is
+ *                 overwritten.
+ *
+ * This is the last section of Counting Sort: the prefix sum of count[] gives
+ * the position where the keys with each digit start.
+ */
+static void scatter_digits(struct radix_portion *portion, int shift,
+                           unsigned mask, long long *count)
+{
+    const unsigned *keys = portion->keys;
+    unsigned *out = portion->keys_tmp;
+
+    long long start = 0;
+    for (unsigned i = 0; i <= mask; i++) {
+        long long count_i = count[i];
+        count[i] = start;
+        start += count_i;
+    }
+
+    if (portion->payload == NULL) {
+        for (long long i = 0; i < portion->size; i++)
+            out[count[(keys[i] >> shift) & mask]++] = keys[i];
+        return;
+    }
+
+    const size_t payload_size = portion->payload_size;
+    for (long long i = 0; i < portion->size; i++) {
+        long long j = count[(keys[i] >> shift) & mask]++;
+        out[j] = keys[i];
+        memcpy(portion->payload_tmp + j * payload_size,
+               portion->payload + i * payload_size, payload_size);
+    }
+}
+
+
+/**
+ * @brief Swap the buffers of a portion with their temporary ones.
+ * @param portion: The portion.
+ */
+static void swap_buffers(struct radix_portion *portion) {
+    unsigned *keys = portion->keys;
+    portion->keys = portion->keys_tmp;
+    portion->keys_tmp = keys;
+
+    char *payload = portion->payload;
+    portion->payload = portion->payload_tmp;
+    portion->payload_tmp = payload;
+}
+
+
+
+bool radix_pass(struct radix_portion *portion, int shift, int bits,
+                int num_proc, int rank)
+{
+    const int num_digits = 1 << bits;
+    const unsigned mask = num_digits - 1;
+    const long long *offsets = portion->offsets;
+    const long long size = offsets[num_proc];
+
+    long long *count = (long long *)safe_alloc(num_digits * sizeof(long long));
+    long long *total = (long long *)safe_alloc(num_digits * sizeof(long long));
+    long long *before = (long long *)safe_alloc(num_digits * sizeof(long long));
+
+    /*
+     * Count the digits in the portion, then find how many elements have each
+     * digit in the whole array and in the processes with lower rank.
+     */
+    count_digits(portion->keys, portion->size, shift, mask, count);
+    MPI_Allreduce(count, total, num_digits, MPI_LONG_LONG, MPI_SUM,
+                  MPI_COMM_WORLD);
+    MPI_Exscan(count, before, num_digits, MPI_LONG_LONG, MPI_SUM,
+               MPI_COMM_WORLD);
+    if (rank == 0)
+        memset(before, 0, num_digits * sizeof(long long));
+
+    /* A digit shared by all elements would leave every element in place. */
+    for (int i = 0; i < num_digits; i++)
+        if (total[i] == size) {
+            free(count);
+            free(total);
+            free(before);
+            return false;
+        }
+
+    long long *send_counts = (long long *)safe_alloc(num_proc *
+                                                     sizeof(long long));
+    long long *recv_counts = (long long *)safe_alloc(num_proc *
+                                                     sizeof(long long));
+    long long *send_displs = (long long *)safe_alloc(num_proc *
+                                                     sizeof(long long));
+    long long *recv_displs = (long long *)safe_alloc(num_proc *
+                                                     sizeof(long long));
+    for (int i = 0; i < num_proc; i++)
+        send_counts[i] = 0;
+
+    /*
+     * The elements of the portion with digit `i` go to the positions starting
+     * after all the elements with a lower digit and all the elements with the
+     * same digit owned by processes with lower rank. These positions grow with
+     * the digit, so once scattered the elements are already grouped by the
+     * process owning their positions.
+     */
+    long long digit_start = 0;
+    int owner = 0;
+    for (int i = 0; i < num_digits; i++) {
+        long long position = digit_start + before[i];
+        long long remaining = count[i];
+        while (remaining > 0) {
+            while (offsets[owner + 1] <= position)
+                owner++;
+            long long taken = offsets[owner + 1] - position;
+            if (taken > remaining)
+                taken = remaining;
+            send_counts[owner] += taken;
+            position += taken;
+            remaining -= taken;
+        }
+        digit_start += total[i];
+    }
+    scatter_digits(portion, shift, mask, count);
+
+    MPI_Alltoall(send_counts, 1, MPI_LONG_LONG, recv_counts, 1,
+                 MPI_LONG_LONG, MPI_COMM_WORLD);
+    send_displs[0] = 0;
+    recv_displs[0] = 0;
+    for (int i = 1; i < num_proc; i++) {
+        send_displs[i] = send_displs[i - 1] + send_counts[i - 1];
+        recv_displs[i] = recv_displs[i - 1] + recv_counts[i - 1];
+    }
+
+    /*
+     * The scattered elements are in the temporary buffers: the received ones
+     * are stored in place of the original ones, which are no longer needed.
+     */
+    array_alltoallv(portion->keys_tmp, send_counts, send_displs,
+                    portion->keys, recv_counts, recv_displs, MPI_UNSIGNED,
+                    num_proc);
+    if (portion->payload != NULL) {
+        /* Payloads are moved as opaque blocks of bytes. */
+        MPI_Datatype payload_type;
+        MPI_Type_contiguous(portion->payload_size, MPI_BYTE, &payload_type);
+        MPI_Type_commit(&payload_type);
+        array_alltoallv(portion->payload_tmp, send_counts, send_displs,
+                        portion->payload, recv_counts, recv_displs,
+                        payload_type, num_proc);
+        MPI_Type_free(&payload_type);
+    }
+
+    /*
+     * The elements arrive ordered by the rank of their sender and, for each
+     * sender, by digit: scattering them once more by digit leaves the elements
+     * with the same digit in the order of the processes they came from, which
+     * is their order in the whole array.
+     */
+    count_digits(portion->keys, portion->size, shift, mask, count);
+    scatter_digits(portion, shift, mask, count);
+    swap_buffers(portion);
+
+    free(count);
+    free(total);
+    free(before);
+    free(send_counts);
+    free(recv_counts);
+    free(send_displs);
+    free(recv_displs);
+    return true;
+}
+
+
+void radix_sort_dist(int *local_array, long long local_size, int min, int max,
+                     int bits, int num_proc, int rank)
+{
+    radix_sort_kv_dist(local_array, NULL, 0, local_size, min, max, bits,
+                       num_proc, rank);
+}
+
+
+void radix_sort_kv_dist(int *local_keys, void *local_payload,
+                        size_t payload_size, long long local_size, int min,
+                        int max, int bits, int num_proc, int rank)
+{
+    /* Only the bits needed to represent the distance from min are sorted. */
+    const unsigned range = (unsigned)max - (unsigned)min;
+    int key_bits = 0;
+    while (key_bits < 32 && (range >> key_bits) != 0)
+        key_bits++;
+
+    /* Position of the portion of every process in the whole array. */
+    long long *offsets = (long long *)safe_alloc((num_proc + 1) *
+                                                 sizeof(long long));
+    offsets[0] = 0;
+    MPI_Allgather(&local_size, 1, MPI_LONG_LONG, offsets + 1, 1, MPI_LONG_LONG,
+                  MPI_COMM_WORLD);
+    for (int i = 1; i <= num_proc; i++)
+        offsets[i] += offsets[i - 1];
+
+    /* A process could own no elements, but the allocation can not be empty. */
+    const long long alloc_size = local_size > 0 ? local_size : 1;
+    struct radix_portion portion = {
+        .keys = (unsigned *)local_keys,
+        .keys_tmp = (unsigned *)safe_alloc(alloc_size * sizeof(unsigned)),
+        .payload = (char *)local_payload,
+        .payload_tmp = NULL,
+        .payload_size = payload_size,
+        .size = local_size,
+        .offsets = offsets
+    };
+    if (local_payload != NULL)
+        portion.payload_tmp = (char *)safe_alloc(alloc_size * payload_size);
+
+    /*
+     * The keys are replaced, in place, by their distance from min: as
+     * unsigned integers their order is the same as that of the keys.
+     */
+    for (long long i = 0; i < local_size; i++)
+        portion.keys[i] = (unsigned)local_keys[i] - (unsigned)min;
+
+    /* The last digit only holds the bits left, keeping its count[] smaller. */
+    for (int shift = 0; shift < key_bits; shift += bits)
+        radix_pass(&portion, shift,
+                   key_bits - shift < bits ? key_bits - shift : bits, num_proc,
+                   rank);
+
+    /* After an odd number of passes the elements are in the other buffers. */
+    if (portion.keys != (unsigned *)local_keys) {
+        memcpy(local_keys, portion.keys, local_size * sizeof(unsigned));
+        if (local_payload != NULL)
+            memcpy(local_payload, portion.payload, local_size * payload_size);
+        swap_buffers(&portion);
+    }
+    for (long long i = 0; i < local_size; i++)
+        local_keys[i] = (int)(portion.keys[i] + (unsigned)min);
+
+    free(portion.keys_tmp);
+    free(portion.payload_tmp);
+    free(offsets);
+}
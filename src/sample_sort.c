@@ -0,0 +1,287 @@
+/**
+ * @file sample_sort.c
+ * @brief This file contains a distributed Sample Sort, for arrays whose range
+ *        is too wide to be counted.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "sample_sort.h"
+
+#include <limits.h>
+#include <mpi.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "partition.h"
+#include "util.h"
+
+
+/**
+ * @brief Compare two samples, each made of a value and of its position in the
+ *        whole array, to be used with `qsort()`.
+ * @param a: First sample.
+ * @param b: Second sample.
+ * @return Negative, zero or positive if the first sample is lesser, equal or
+ *         greater than the second one.
+ */
+static int compare_samples(const void *a, const void *b) {
+    const long long *sample_a = (const long long *)a;
+    const long long *sample_b = (const long long *)b;
+    if (sample_a[0] != sample_b[0])
+        return (sample_a[0] > sample_b[0]) - (sample_a[0] < sample_b[0]);
+    return (sample_a[1] > sample_b[1]) - (sample_a[1] < sample_b[1]);
+}
+
+
+/**
+ * @brief Merge consecutive sorted runs into a single sorted one.
+ * @param runs:     The runs, one after the other.
+ * @param tmp:      Buffer as big as the runs.
+ * @param starts:   Position where each run starts, plus the end of the last
+ *                  one as last item (input/output).
+ * @param num_runs: Number of runs.
+ * @return Either `runs` or `tmp`, whichever holds the merged elements.
+ *
+ * Runs are merged in pairs, halving their number at every round; the pairs of
+ * each round are merged by the OpenMP threads.
+ */
+static int *merge_runs(int *runs, int *tmp, long long *starts, int num_runs) {
+    while (num_runs > 1) {
+        #pragma omp parallel for schedule(dynamic)
+        for (int i = 0; i < num_runs; i += 2) {
+            long long a = starts[i], b = starts[i + 1], out = starts[i];
+            const long long end_a = starts[i + 1];
+            const long long end_b = i + 1 < num_runs ? starts[i + 2] : end_a;
+            while (a < end_a && b < end_b)
+                tmp[out++] = runs[b] < runs[a] ? runs[b++] : runs[a++];
+            memcpy(tmp + out, runs + a, (end_a - a) * sizeof(int));
+            out += end_a - a;
+            memcpy(tmp + out, runs + b, (end_b - b) * sizeof(int));
+        }
+
+        /* Run `i` of the next round starts where run `2 * i` did. */
+        const int merged_runs = (num_runs + 1) / 2;
+        for (int i = 0; i <= merged_runs; i++)
+            starts[i] = starts[2 * i < num_runs ? 2 * i : num_runs];
+        num_runs = merged_runs;
+        int *swap = runs;
+        runs = tmp;
+        tmp = swap;
+    }
+    return runs;
+}
+
+
+/**
+ * @brief Sort an array by splitting it among the OpenMP threads.
+ * @param array: The array.
+ * @param tmp:   Buffer as big as the array.
+ * @param size:  Number of elements in the array.
+ * @return Either `array` or `tmp`, whichever holds the sorted elements.
+ */
+static int *local_sort(int *array, int *tmp, long long size) {
+    int num_chunks = 1;
+#ifdef _OPENMP
+    num_chunks = omp_get_max_threads();
+#endif
+    long long *starts = (long long *)safe_alloc((num_chunks + 1) *
+                                                sizeof(long long));
+    for (int i = 0; i <= num_chunks; i++)
+        starts[i] = size * i / num_chunks;
+
+    #pragma omp parallel for
+    for (int i = 0; i < num_chunks; i++)
+        qsort(array + starts[i], starts[i + 1] - starts[i], sizeof(int),
+              compare_ints);
+
+    int *sorted = merge_runs(array, tmp, starts, num_chunks);
+    free(starts);
+    return sorted;
+}
+
+
+/**
+ * @brief Count the elements of a sorted portion lesser than a splitter, equal
+ *        elements being ordered by their position in the whole array.
+ * @param array:    The sorted portion.
+ * @param size:     Number of elements in the portion.
+ * @param offset:   Position of the portion in the whole array.
+ * @param value:    Value of the splitter.
+ * @param position: Position of the splitter in the whole array.
+ * @return Number of elements lesser than the splitter.
+ */
+static long long split_point(const int *array, long long size, long long offset,
+                             long long value, long long position)
+{
+    /* First element not lesser than the value, then first one greater. */
+    long long low = 0, high = size;
+    while (low < high) {
+        long long mid = low + (high - low) / 2;
+        if (array[mid] < value)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    long long first = low;
+    high = size;
+    while (low < high) {
+        long long mid = low + (high - low) / 2;
+        if (array[mid] <= value)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    long long last = low;
+
+    /* Equal elements before the position of the splitter come first. */
+    long long split = position - offset;
+    return split < first ? first : split > last ? last : split;
+}
+
+
+
+void sample_sort_dist(int *local_array, long long local_size, int num_proc,
+                      int rank)
+{
+    /* Position of the portion of every process in the whole array. */
+    long long *offsets = (long long *)safe_alloc((num_proc + 1) *
+                                                 sizeof(long long));
+    offsets[0] = 0;
+    MPI_Allgather(&local_size, 1, MPI_LONG_LONG, offsets + 1, 1, MPI_LONG_LONG,
+                  MPI_COMM_WORLD);
+    for (int i = 1; i <= num_proc; i++)
+        offsets[i] += offsets[i - 1];
+    const long long local_offset = offsets[rank];
+
+    /* A process could own no elements, but the allocation can not be empty. */
+    int *tmp = (int *)safe_alloc((local_size > 0 ? local_size : 1) *
+                                 sizeof(int));
+    int *sorted = local_sort(local_array, tmp, local_size);
+
+    /*
+     * Every process takes `num_proc - 1` regularly spaced samples, each one a
+     * value with its position; an empty portion gives samples greater than
+     * any other.
+     */
+    const int samples_per_proc = num_proc - 1;
+    const int num_samples = num_proc * samples_per_proc;
+    long long *local_samples = (long long *)safe_alloc(
+        (2 * samples_per_proc + 1) * sizeof(long long));
+    for (int i = 0; i < samples_per_proc; i++) {
+        long long j = (i + 1) * local_size / num_proc;
+        local_samples[2 * i] = local_size > 0 ? sorted[j] : INT_MAX + 1LL;
+        local_samples[2 * i + 1] = local_offset + j;
+    }
+    long long *samples = (long long *)safe_alloc(
+        (2 * num_samples + 1) * sizeof(long long));
+    MPI_Allgather(local_samples, 2 * samples_per_proc, MPI_LONG_LONG, samples,
+                  2 * samples_per_proc, MPI_LONG_LONG, MPI_COMM_WORLD);
+    qsort(samples, num_samples, 2 * sizeof(long long), compare_samples);
+
+    /*
+     * Splitter `i` is the sample at quantile (i + 1) / num_proc; the sorted
+     * portion is cut where each splitter would be.
+     */
+    long long *send_counts = (long long *)safe_alloc(num_proc *
+                                                     sizeof(long long));
+    long long *recv_counts = (long long *)safe_alloc(num_proc *
+                                                     sizeof(long long));
+    long long *send_displs = (long long *)safe_alloc(num_proc *
+                                                     sizeof(long long));
+    long long *recv_displs = (long long *)safe_alloc(num_proc *
+                                                     sizeof(long long));
+    long long previous = 0;
+    for (int i = 0; i < num_proc; i++) {
+        long long next = local_size;
+        if (i < num_proc - 1) {
+            const long long *splitter = samples +
+                                        2 * ((i + 1) * num_samples / num_proc);
+            next = split_point(sorted, local_size, local_offset, splitter[0],
+                               splitter[1]);
+        }
+        send_displs[i] = previous;
+        send_counts[i] = next - previous;
+        previous = next;
+    }
+
+    MPI_Alltoall(send_counts, 1, MPI_LONG_LONG, recv_counts, 1,
+                 MPI_LONG_LONG, MPI_COMM_WORLD);
+    long long *starts = (long long *)safe_alloc((num_proc + 1) *
+                                                sizeof(long long));
+    starts[0] = 0;
+    for (int i = 0; i < num_proc; i++) {
+        recv_displs[i] = starts[i];
+        starts[i + 1] = starts[i] + recv_counts[i];
+    }
+    const long long bucket_size = starts[num_proc];
+
+    /* The bucket arrives as one sorted run from each process. */
+    int *bucket = (int *)safe_alloc((bucket_size > 0 ? bucket_size : 1) *
+                                    sizeof(int));
+    int *bucket_tmp = (int *)safe_alloc((bucket_size > 0 ? bucket_size : 1) *
+                                        sizeof(int));
+    array_alltoallv(sorted, send_counts, send_displs, bucket, recv_counts,
+                    recv_displs, MPI_INT, num_proc);
+    int *merged = merge_runs(bucket, bucket_tmp, starts, num_proc);
+
+    /*
+     * The buckets follow each other in rank order: each one is sent to the
+     * processes whose portions overlap its positions.
+     */
+    long long bucket_offset = 0;
+    MPI_Exscan(&bucket_size, &bucket_offset, 1, MPI_LONG_LONG, MPI_SUM,
+               MPI_COMM_WORLD);
+    if (rank == 0)
+        bucket_offset = 0;
+    for (int i = 0; i < num_proc; i++) {
+        long long first = offsets[i] > bucket_offset ? offsets[i]
+                                                      : bucket_offset;
+        long long last = offsets[i + 1] < bucket_offset + bucket_size
+                         ? offsets[i + 1] : bucket_offset + bucket_size;
+        send_displs[i] = last > first ? first - bucket_offset : 0;
+        send_counts[i] = last > first ? last - first : 0;
+    }
+    MPI_Alltoall(send_counts, 1, MPI_LONG_LONG, recv_counts, 1,
+                 MPI_LONG_LONG, MPI_COMM_WORLD);
+    recv_displs[0] = 0;
+    for (int i = 1; i < num_proc; i++)
+        recv_displs[i] = recv_displs[i - 1] + recv_counts[i - 1];
+    array_alltoallv(merged, send_counts, send_displs, local_array,
+                    recv_counts, recv_displs, MPI_INT, num_proc);
+
+    free(offsets);
+    free(tmp);
+    free(local_samples);
+    free(samples);
+    free(send_counts);
+    free(recv_counts);
+    free(send_displs);
+    free(recv_displs);
+    free(starts);
+    free(bucket);
+    free(bucket_tmp);
+}
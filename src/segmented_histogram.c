@@ -0,0 +1,163 @@
+/**
+ * @file segmented_histogram.c
+ * @brief This file contains the reduction of the histograms of all processes
+ *        into segments of the range, each one owned by a single process.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include "segmented_histogram.h"
+
+#include <mpi.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "util.h"
+
+
+
+struct run *segmented_count(const int *local_array, long long local_size,
+                            int min, int max, const long long *offsets,
+                            enum histogram_kernel kernel, int num_proc,
+                            int rank, long long *num_runs)
+{
+    /* The range is padded to a whole number of segments. */
+    const long long count_size = (long long)max - min + 1;
+    const int segment = (count_size + num_proc - 1) / num_proc;
+
+    /* The portion is grouped by segment, so each one is counted by itself. */
+    long long *starts = (long long *)safe_alloc((num_proc + 1) *
+                                                sizeof(long long));
+    memset(starts, 0, (num_proc + 1) * sizeof(long long));
+    for (long long i = 0; i < local_size; i++)
+        starts[((long long)local_array[i] - min) / segment + 1]++;
+    for (int j = 0; j < num_proc; j++)
+        starts[j + 1] += starts[j];
+    long long *next = (long long *)safe_alloc(num_proc * sizeof(long long));
+    memcpy(next, starts, num_proc * sizeof(long long));
+    int *grouped = (int *)safe_alloc((local_size > 0 ? local_size : 1) *
+                                     sizeof(int));
+    for (long long i = 0; i < local_size; i++)
+        grouped[next[((long long)local_array[i] - min) / segment]++] =
+            local_array[i];
+    free(next);
+
+    /*
+     * Segment `j` is counted and reduced into process `j` while segment
+     * `j + 1` is counted in the other buffer: only two local count[] of one
+     * segment each are allocated.
+     */
+    int *owned = (int *)safe_alloc(segment * sizeof(int));
+    int *count[2];
+    count[0] = (int *)huge_alloc(segment * sizeof(int), false);
+    count[1] = (int *)huge_alloc(segment * sizeof(int), false);
+    MPI_Request requests[2] = {MPI_REQUEST_NULL, MPI_REQUEST_NULL};
+    for (int j = 0; j < num_proc; j++) {
+        const int b = j % 2;
+        MPI_Wait(&requests[b], MPI_STATUS_IGNORE);
+        histogram_count(grouped + starts[j], starts[j + 1] - starts[j],
+                        min + (long long)j * segment, count[b], segment,
+                        kernel);
+        MPI_Ireduce(count[b], owned, segment, MPI_INT, MPI_SUM, j,
+                    MPI_COMM_WORLD, &requests[b]);
+    }
+    MPI_Waitall(2, requests, MPI_STATUSES_IGNORE);
+    huge_free(count[0], segment * sizeof(int));
+    huge_free(count[1], segment * sizeof(int));
+    free(grouped);
+    free(starts);
+
+    /*
+     * The segments follow each other in rank order, and so do the positions
+     * of their values in the sorted array.
+     */
+    long long total = 0, nonzero = 0;
+    for (int i = 0; i < segment; i++) {
+        total += owned[i];
+        nonzero += owned[i] > 0;
+    }
+    long long position = 0;
+    MPI_Exscan(&total, &position, 1, MPI_LONG_LONG, MPI_SUM, MPI_COMM_WORLD);
+    if (rank == 0)
+        position = 0;
+
+    /*
+     * A value whose positions cross the end of a portion is split between
+     * the owners of the portions: there are `num_proc - 1` ends at most.
+     */
+    struct run *send = (struct run *)safe_alloc((nonzero + num_proc) *
+                                                sizeof(struct run));
+    int *send_counts = (int *)safe_alloc(num_proc * sizeof(int));
+    int *recv_counts = (int *)safe_alloc(num_proc * sizeof(int));
+    int *send_displs = (int *)safe_alloc(num_proc * sizeof(int));
+    int *recv_displs = (int *)safe_alloc(num_proc * sizeof(int));
+    for (int i = 0; i < num_proc; i++)
+        send_counts[i] = 0;
+    const long long first_value = (long long)min + (long long)rank * segment;
+    long long num_send = 0;
+    int owner = 0;
+    for (int i = 0; i < segment; i++) {
+        long long remaining = owned[i];
+        while (remaining > 0) {
+            while (offsets[owner + 1] <= position)
+                owner++;
+            long long taken = offsets[owner + 1] - position;
+            if (taken > remaining)
+                taken = remaining;
+            send[num_send].value = first_value + i;
+            send[num_send].count = taken;
+            num_send++;
+            send_counts[owner]++;
+            position += taken;
+            remaining -= taken;
+        }
+    }
+    free(owned);
+
+    MPI_Alltoall(send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT,
+                 MPI_COMM_WORLD);
+    send_displs[0] = 0;
+    recv_displs[0] = 0;
+    for (int i = 1; i < num_proc; i++) {
+        send_displs[i] = send_displs[i - 1] + send_counts[i - 1];
+        recv_displs[i] = recv_displs[i - 1] + recv_counts[i - 1];
+    }
+    *num_runs = recv_displs[num_proc - 1] + recv_counts[num_proc - 1];
+
+    /* Runs arrive from the segments in rank order, so sorted by value. */
+    struct run *runs = (struct run *)safe_alloc((*num_runs + 1) *
+                                                sizeof(struct run));
+    MPI_Datatype run_type;
+    sparse_run_type(&run_type);
+    MPI_Alltoallv(send, send_counts, send_displs, run_type, runs, recv_counts,
+                  recv_displs, run_type, MPI_COMM_WORLD);
+    MPI_Type_free(&run_type);
+
+    free(send);
+    free(send_counts);
+    free(recv_counts);
+    free(send_displs);
+    free(recv_displs);
+    return runs;
+}
@@ -0,0 +1,227 @@
+/**
+ * @file sparse_histogram.c
+ * @brief This file contains the functions needed to count the occurrences of
+ *        the values in an array when they are sparse in a wide range, without
+ *        allocating one counter for each value of the range.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "sparse_histogram.h"
+
+#include <mpi.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "fill.h"
+#include "util.h"
+
+/** @brief Tag of the messages carrying runs between processes. */
+#define TAG_RUNS 3
+
+
+/**
+ * @brief Compare two runs by their value, to be used with `qsort()`.
+ * @param a: First run.
+ * @param b: Second run.
+ * @return Negative, zero or positive if the first value is lesser, equal or
+ *         greater than the second one.
+ */
+static int compare_runs(const void *a, const void *b) {
+    int value_a = ((const struct run *)a)->value;
+    int value_b = ((const struct run *)b)->value;
+    return (value_a > value_b) - (value_a < value_b);
+}
+
+
+/**
+ * @brief Merge two arrays of runs sorted by value into a new one, adding up the
+ *        counts of the values they have in common.
+ * @param a:        First array of runs.
+ * @param num_a:    Number of runs in the first array.
+ * @param b:        Second array of runs.
+ * @param num_b:    Number of runs in the second array.
+ * @param num_runs: Number of runs in the merged array (output).
+ * @return The merged runs, sorted by value.
+ */
+static struct run *merge_runs(const struct run *a, long long num_a,
+                              const struct run *b, long long num_b,
+                              long long *num_runs)
+{
+    struct run *merged = (struct run *)safe_alloc((num_a + num_b + 1) *
+                                                  sizeof(struct run));
+    long long i = 0, j = 0, k = 0;
+
+    while (i < num_a && j < num_b) {
+        if (a[i].value < b[j].value)
+            merged[k++] = a[i++];
+        else if (a[i].value > b[j].value)
+            merged[k++] = b[j++];
+        else {
+            merged[k] = a[i++];
+            merged[k++].count += b[j++].count;
+        }
+    }
+    while (i < num_a)
+        merged[k++] = a[i++];
+    while (j < num_b)
+        merged[k++] = b[j++];
+
+    *num_runs = k;
+    return merged;
+}
+
+
+
+struct run *sparse_count(const int *array, long long size, long long *num_runs)
+{
+    /*
+     * The table can never hold more distinct values than there are elements;
+     * it is kept at most half full so that probe sequences stay short. Its
+     * capacity is a power of two so that the hash can be reduced with a mask.
+     */
+    long long capacity = 16;
+    while (capacity < 2 * size)
+        capacity <<= 1;
+    const unsigned long long mask = capacity - 1;
+
+    /* A slot with a count of 0 is empty. */
+    struct run *table = (struct run *)safe_alloc(capacity * sizeof(struct run));
+    for (long long i = 0; i < capacity; i++)
+        table[i].count = 0;
+
+    for (long long i = 0; i < size; i++) {
+        /* Fibonacci hashing spreads consecutive values over the table. */
+        unsigned long long slot =
+            ((unsigned)array[i] * 0x9E3779B97F4A7C15ULL >> 32) & mask;
+        /* Linear probing until the value or an empty slot is found. */
+        while (table[slot].count != 0 && table[slot].value != array[i])
+            slot = (slot + 1) & mask;
+        table[slot].value = array[i];
+        table[slot].count += 1;
+    }
+
+    /* Compact the occupied slots at the beginning of the table and sort them. */
+    long long k = 0;
+    for (long long i = 0; i < capacity; i++)
+        if (table[i].count != 0)
+            table[k++] = table[i];
+    qsort(table, k, sizeof(struct run), compare_runs);
+
+    *num_runs = k;
+    return table;
+}
+
+
+void sparse_run_type(MPI_Datatype *type) {
+    const int lengths[2] = {1, 1};
+    const MPI_Aint displs[2] = {offsetof(struct run, value),
+                                offsetof(struct run, count)};
+    const MPI_Datatype types[2] = {MPI_INT, MPI_INT};
+    MPI_Datatype run;
+    MPI_Type_create_struct(2, lengths, displs, types, &run);
+    /* Consecutive runs are as far apart as in an array of them. */
+    MPI_Type_create_resized(run, 0, sizeof(struct run), type);
+    MPI_Type_commit(type);
+    MPI_Type_free(&run);
+}
+
+
+struct run *sparse_reduce(struct run *runs, long long *num_runs, int num_proc,
+                          int rank)
+{
+    /*
+     * At every step, the processes whose rank has the step bit set send their
+     * runs to the process `step` positions before them and drop out; the
+     * receivers merge them with their own.
+     */
+    MPI_Datatype run_type;
+    sparse_run_type(&run_type);
+    for (int step = 1; step < num_proc; step <<= 1) {
+        if (rank & step) {
+            MPI_Send(runs, *num_runs, run_type, rank - step, TAG_RUNS,
+                     MPI_COMM_WORLD);
+            break;
+        }
+        if (rank + step < num_proc) {
+            MPI_Status status;
+            int num_recv = 0;
+            MPI_Probe(rank + step, TAG_RUNS, MPI_COMM_WORLD, &status);
+            MPI_Get_count(&status, run_type, &num_recv);
+
+            struct run *recv = (struct run *)safe_alloc((num_recv + 1) *
+                                                        sizeof(struct run));
+            MPI_Recv(recv, num_recv, run_type, rank + step, TAG_RUNS,
+                     MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+
+            struct run *merged = merge_runs(runs, *num_runs, recv, num_recv,
+                                            num_runs);
+            free(runs);
+            free(recv);
+            runs = merged;
+        }
+    }
+
+    /* Process 0 holds the merged runs: share them with all processes. */
+    MPI_Bcast(num_runs, 1, MPI_LONG_LONG, 0, MPI_COMM_WORLD);
+    if (rank != 0) {
+        free(runs);
+        runs = (struct run *)safe_alloc((*num_runs + 1) * sizeof(struct run));
+    }
+    MPI_Bcast(runs, *num_runs, run_type, 0, MPI_COMM_WORLD);
+    MPI_Type_free(&run_type);
+    return runs;
+}
+
+
+void sparse_expand(int *out, const struct run *runs, long long num_runs,
+                   long long first, long long last)
+{
+    /* Position where each run starts in the sorted array. */
+    long long *starts = (long long *)safe_alloc((num_runs + 1) *
+                                                sizeof(long long));
+    starts[0] = 0;
+    for (long long i = 0; i < num_runs; i++)
+        starts[i + 1] = starts[i] + runs[i].count;
+
+    /*
+     * Every thread writes an equal number of positions, even when a few runs
+     * hold most of the elements.
+     */
+    const bool streaming = fill_streaming(last - first);
+    #pragma omp parallel num_threads(fill_threads(last - first))
+    {
+        long long begin = 0, end = 0;
+        fill_slice(first, last, &begin, &end);
+
+        long long k = begin;
+        for (long long i = fill_find_run(starts, num_runs, begin); k < end;
+             i++) {
+            long long run_end = starts[i + 1] < end ? starts[i + 1] : end;
+            fill_run(out + (k - first), run_end - k, runs[i].value, streaming);
+            k = run_end;
+        }
+        fill_end(streaming);
+    }
+
+    free(starts);
+}
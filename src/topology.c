@@ -0,0 +1,109 @@
+/**
+ * @file topology.c
+ * @brief This file contains the grouping of MPI processes by node, used to
+ *        communicate within each node before communicating among nodes.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "topology.h"
+
+#include <stdlib.h>
+
+#include "util.h"
+
+
+
+void topology_create(struct topology *topo, int ranks_per_node, int num_proc,
+                     int rank)
+{
+    MPI_Comm_split_type(MPI_COMM_WORLD, MPI_COMM_TYPE_SHARED, rank,
+                        MPI_INFO_NULL, &topo->node_comm);
+    /*
+     * The histograms of a NUMA domain are merged first, without crossing the
+     * interconnect between sockets. Only Open MPI can tell the domains apart.
+     */
+    if (ranks_per_node == TOPOLOGY_NUMA) {
+#ifdef OPEN_MPI
+        MPI_Comm shared = topo->node_comm;
+        MPI_Comm_split_type(shared, OMPI_COMM_TYPE_NUMA, rank, MPI_INFO_NULL,
+                            &topo->node_comm);
+        MPI_Comm_free(&shared);
+#endif
+    }
+    else if (ranks_per_node > 0) {
+        MPI_Comm shared = topo->node_comm;
+        MPI_Comm_split(shared, rank / ranks_per_node, rank, &topo->node_comm);
+        MPI_Comm_free(&shared);
+    }
+    int node_rank;
+    MPI_Comm_rank(topo->node_comm, &node_rank);
+    MPI_Comm_size(topo->node_comm, &topo->node_size);
+
+    /* The first process of each node takes part in the exchanges among nodes. */
+    MPI_Comm_split(MPI_COMM_WORLD, node_rank == 0 ? 0 : MPI_UNDEFINED, rank,
+                   &topo->leader_comm);
+    int node = 0;
+    if (topo->leader_comm != MPI_COMM_NULL) {
+        MPI_Comm_rank(topo->leader_comm, &node);
+        MPI_Comm_size(topo->leader_comm, &topo->num_nodes);
+    }
+    MPI_Bcast(&node, 1, MPI_INT, 0, topo->node_comm);
+    MPI_Bcast(&topo->num_nodes, 1, MPI_INT, 0, topo->node_comm);
+    topo->node_of = (int *)safe_alloc(num_proc * sizeof(int));
+    MPI_Allgather(&node, 1, MPI_INT, topo->node_of, 1, MPI_INT,
+                  MPI_COMM_WORLD);
+}
+
+
+void topology_free(struct topology *topo) {
+    MPI_Comm_free(&topo->node_comm);
+    if (topo->leader_comm != MPI_COMM_NULL)
+        MPI_Comm_free(&topo->leader_comm);
+    free(topo->node_of);
+}
+
+
+void topology_allreduce(void *buffer, int count, MPI_Datatype type, MPI_Op op,
+                        const struct topology *topo)
+{
+    int num_proc;
+    MPI_Comm_size(MPI_COMM_WORLD, &num_proc);
+    if (topo == NULL || topo->num_nodes == 1 || topo->num_nodes == num_proc) {
+        MPI_Allreduce(MPI_IN_PLACE, buffer, count, type, op, MPI_COMM_WORLD);
+        return;
+    }
+
+    /* The leader of each node collects the result of its node... */
+    if (topo->leader_comm != MPI_COMM_NULL)
+        MPI_Reduce(MPI_IN_PLACE, buffer, count, type, op, 0, topo->node_comm);
+    else
+        MPI_Reduce(buffer, NULL, count, type, op, 0, topo->node_comm);
+
+    /* ...combines it with those of the other nodes... */
+    if (topo->leader_comm != MPI_COMM_NULL)
+        MPI_Allreduce(MPI_IN_PLACE, buffer, count, type, op,
+                      topo->leader_comm);
+
+    /* ...and hands the result back to its node. */
+    MPI_Bcast(buffer, count, type, 0, topo->node_comm);
+}
@@ -30,6 +30,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "affinity.h"
+#include "partition.h"
 
 
 void *safe_alloc(long long size) {
@@ -54,97 +60,98 @@ void *safe_alloc(long long size) {
 void array_init_random(int *array, long long size, int min, int max,
                        int num_proc, int rank)
 {
-    /* Every process will have a different seed. */
-    unsigned seed = time(NULL) ^ rank;
+    /* Each process fills its own portion of the array. */
+    long long local_offset = 0, local_size = 0;
+    array_block(size, num_proc, rank, &local_offset, &local_size);
+    array_init_random_local(array + local_offset, local_size, min, max, rank);
 
-    /* Divide the total size evenly among every process. */
-    const long long local_size = size / num_proc;
-    /*
-     * The size might not always be perfectly divisible by the number of
-     * processes; in such cases, a portion of the array might be left out. This
-     * is the position in the array where the left out elements start.
-     */
-    long long index_leftout = local_size * num_proc;
+    /* All portions are then collected into the array of every process. */
+    array_gather(array, MPI_INT, size, num_proc);
+}
+
+
+void array_init_from_file(int *array, long long size, const char *file_path,
+                          int num_proc, int rank)
+{
+    /* Each process reads its own portion of the array. */
+    long long local_offset = 0, local_size = 0;
+    array_block(size, num_proc, rank, &local_offset, &local_size);
+    array_init_from_file_local(array + local_offset, local_size, local_offset,
+                               file_path);
+
+    /* All portions are then collected into the array of every process. */
+    array_gather(array, MPI_INT, size, num_proc);
+}
 
-    /* Each process will fill a local array with local_size elements. */
-    int *local_array = (int *)safe_alloc(local_size * sizeof(int));
-    for (long long i = 0; i < local_size; i++)
-        local_array[i] = rand_r(&seed) % (max + 1 - min) + min;
 
-    /* All the local_array are then merged into the one global input array. */
-    MPI_Allgather(local_array, local_size, MPI_INT, array, local_size, MPI_INT,
-                  MPI_COMM_WORLD);
-    free(local_array);
+void array_init_random_local(int *local_array, long long local_size, int min,
+                             int max, int rank)
+{
+    /* Every process, and every thread, will have a different seed. */
+    const unsigned process_seed = time(NULL) ^ rank;
 
     /*
-     * Initialize all the remaining elements.
-     * This section is not parallelized because the number of remaining elements
-     * is, at most, equal to NUM_PROC-1. Using MPI for such a small number would
-     * certainly slow everything down.
+     * Each thread fills the slice of the portion it will count, so the pages
+     * of the slice are first touched, and placed, on its own NUMA node.
      */
-    if (index_leftout < size) {
-        /* Every process will have the same seed. */
-        srand(max - min + num_proc);
-        for (long long i = index_leftout; i < size; i++)
-            array[i] = rand() % (max + 1 - min) + min;
+    #pragma omp parallel
+    {
+        unsigned seed = process_seed;
+#ifdef _OPENMP
+        seed ^= (unsigned)omp_get_thread_num() << 16;
+#endif
+        #pragma omp for schedule(static)
+        for (long long i = 0; i < local_size; i++)
+            local_array[i] = rand_r(&seed) % (max + 1 - min) + min;
     }
 }
 
 
-void array_init_from_file(int *array, long long size, const char *file_path,
-                          int num_proc, int rank)
+void array_init_from_file_local(int *local_array, long long local_size,
+                                long long offset, const char *file_path)
 {
     MPI_File file;
 
-    /* Divide the total size evenly among every process. */
-    const long long local_size = size / num_proc;
-    /*
-     * The size might not always be perfectly divisible by the number of
-     * processes; in such cases, a portion of the array might be left out. This
-     * is the position in the array where the left out elements start.
-     */
-    long long index_leftout = local_size * num_proc;
-
-    /* Each process will fill a local array with local_size elements. */
-    int *local_array = (int *)safe_alloc(local_size * sizeof(int));
+    /* MPI writes from the main thread only: the threads place the pages. */
+    first_touch(local_array, local_size * sizeof(int));
 
     MPI_File_open(MPI_COMM_WORLD, file_path, MPI_MODE_RDONLY, MPI_INFO_NULL,
                   &file);
     /*
-     * Process with rank N reads local_size elements starting at position
-     * N * local_size.
+     * The portion is read starting from its position in the whole array, in
+     * chunks whose count fits in an int.
      */
-    MPI_File_seek(file, local_size * (rank * sizeof(int)), MPI_SEEK_SET);
-    MPI_File_read(file, local_array, local_size, MPI_INT, MPI_STATUS_IGNORE);
+    for (long long first = 0; first < local_size; first += LARGE_COUNT_CHUNK) {
+        long long chunk = local_size - first < LARGE_COUNT_CHUNK
+                          ? local_size - first : LARGE_COUNT_CHUNK;
+        MPI_File_read_at(file, (offset + first) * sizeof(int),
+                         local_array + first, chunk, MPI_INT,
+                         MPI_STATUS_IGNORE);
+    }
+    MPI_File_close(&file);
+}
 
-    /* All the local_array are then merged into the one global input array. */
-    MPI_Allgather(local_array, local_size, MPI_INT, array, local_size, MPI_INT,
-                  MPI_COMM_WORLD);
-    free(local_array);
 
-    /*
-     * Read all the remaining elements.
-     * This section is not parallelized because the number of remaining elements
-     * is, at most, equal to NUM_PROC-1. Using MPI for such a small number would
-     * certainly slow everything down.
-     */
-    if (index_leftout < size) {
-	    MPI_File_seek(file, index_leftout * sizeof(int), MPI_SEEK_SET);
-        MPI_File_read(file, array + index_leftout, size - index_leftout,
-                      MPI_INT, MPI_STATUS_IGNORE);
+void array_min_max(const int *array, long long size, int *min, int *max) {
+    int local_min = array[0];
+    int local_max = array[0];
+
+    /* When compiled with OpenMP, every thread scans a slice of the array. */
+    #pragma omp parallel for reduction(min: local_min) reduction(max: local_max)
+    for (long long i = 0; i < size; i++) {
+        if (array[i] < local_min)
+            local_min = array[i];
+        if (array[i] > local_max)
+            local_max = array[i];
     }
 
-    MPI_File_close(&file);
+    *min = local_min;
+    *max = local_max;
 }
 
 
-void array_min_max(const int *array, long long size, int *min, int *max) {
-    *min = array[0];
-    *max = array[0];
-
-    for (long long i = 0; i < size; i++)
-        if (array[i] < *min)
-            *min = array[i];
-        else if (array[i] > *max)
-            *max = array[i];
+int compare_ints(const void *a, const void *b) {
+    int value_a = *(const int *)a;
+    int value_b = *(const int *)b;
+    return (value_a > value_b) - (value_a < value_b);
 }
@@ -0,0 +1,165 @@
+/**
+ * @file bench.c
+ * @brief This file contains a microbenchmark comparing the kernels that count
+ *        the occurrences of each value in an array.
+ * @author Marco Plaitano
+ * @date 27 Nov 2021
+ *
+ * COUNTING SORT MPI
+ * Parallelize and Evaluate Performances of "Counting Sort" Algorithm, by using
+ * MPI.
+ *
+ * Copyright (C) 2022 Plaitano Marco
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "histogram.h"
+#include "util.h"
+
+/** Number of elements counted when not given as command line argument. */
+#define DEFAULT_SIZE 20000000
+
+/** Number of times each measure is repeated; the best one is kept. */
+#define NUM_REPEATS 3
+
+/** Number of ranges the kernels are measured with. */
+#define NUM_RANGES 8
+
+/** Number of kernels to compare. */
+#define NUM_KERNELS 7
+
+
+/**
+ * @brief Fill the array with values in [0; range) following a Zipf
+ *        distribution, where value `i` occurs proportionally to `1 / (i + 1)`.
+ * @param array: The array.
+ * @param size:  Number of elements in the array.
+ * @param range: Number of distinct values.
+ */
+void array_init_zipf(int *array, long long size, int range);
+
+/**
+ * @brief Measure how many elements per second a kernel counts.
+ * @param array:  The array.
+ * @param size:   Number of elements in the array.
+ * @param range:  Number of distinct values in the array, starting from 0.
+ * @param kernel: The kernel.
+ * @return Millions of elements counted per second, in the best repetition.
+ */
+double measure_kernel(const int *array, long long size, int range,
+                      enum histogram_kernel kernel);
+
+
+
+int main(int argc, char **argv) {
+    int thread_support;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
+
+    const long long size = argc > 1 ? atoll(argv[1]) : DEFAULT_SIZE;
+    const int ranges[NUM_RANGES] = {256,    1000,    10000,    65536,
+                                    100000, 1000000, 10000000, 100000000};
+    const enum histogram_kernel kernels[NUM_KERNELS] = {
+        KERNEL_SCALAR, KERNEL_FIXED, KERNEL_INTERLEAVED, KERNEL_AVX512,
+        KERNEL_BLOCKED, KERNEL_PREFETCH, KERNEL_AUTO
+    };
+    const char *kernel_names[NUM_KERNELS] = {"scalar", "fixed", "interleaved",
+                                             "avx512", "blocked", "prefetch",
+                                             "auto"};
+
+#ifdef _OPENMP
+    /* Measures are per core: threads would only hide the kernel itself. */
+    omp_set_num_threads(1);
+#endif
+
+    int *array = (int *)safe_alloc(size * sizeof(int));
+
+    fprintf(stdout, "distribution;range;kernel;Melements/s\n");
+    for (int zipf = 0; zipf <= 1; zipf++)
+        for (int r = 0; r < NUM_RANGES; r++) {
+            if (zipf)
+                array_init_zipf(array, size, ranges[r]);
+            else
+                array_init_random(array, size, 0, ranges[r] - 1, 1, 0);
+
+            for (int k = 0; k < NUM_KERNELS; k++) {
+                if (!histogram_kernel_supported(kernels[k]))
+                    continue;
+                fprintf(stdout, "%s;%d;%s;%.1f\n", zipf ? "zipf" : "uniform",
+                        ranges[r], kernel_names[k],
+                        measure_kernel(array, size, ranges[r], kernels[k]));
+                fflush(stdout);
+            }
+        }
+
+    free(array);
+    MPI_Finalize();
+    return EXIT_SUCCESS;
+}
+
+
+
+void array_init_zipf(int *array, long long size, int range) {
+    /* Cumulative distribution of the values. */
+    double *cdf = (double *)safe_alloc(range * sizeof(double));
+    double sum = 0;
+    for (int i = 0; i < range; i++) {
+        sum += 1.0 / (i + 1);
+        cdf[i] = sum;
+    }
+
+    unsigned seed = 42;
+    for (long long i = 0; i < size; i++) {
+        double u = (double)rand_r(&seed) / RAND_MAX * sum;
+        /* First value whose cumulative probability reaches u. */
+        int low = 0, high = range - 1;
+        while (low < high) {
+            int mid = (low + high) / 2;
+            if (cdf[mid] < u)
+                low = mid + 1;
+            else
+                high = mid;
+        }
+        array[i] = low;
+    }
+
+    free(cdf);
+}
+
+
+double measure_kernel(const int *array, long long size, int range,
+                      enum histogram_kernel kernel)
+{
+    int *count = (int *)safe_alloc(range * sizeof(int));
+    double best = 0;
+
+    for (int i = 0; i < NUM_REPEATS; i++) {
+        double time = 0;
+        START_TIME(time);
+        histogram_count(array, size, 0, count, range, kernel);
+        END_TIME(time);
+        if (best == 0 || time < best)
+            best = time;
+    }
+
+    free(count);
+    return size / best * 1e-6;
+}
@@ -25,17 +25,52 @@
  * along with this program. If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <limits.h>
 #include <mpi.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 
+#include "affinity.h"
+#include "arena.h"
 #include "counting_sort.h"
+#include "partition.h"
+#include "planner.h"
 #include "util.h"
 
 /** Number of array sizes the program is tested with. */
 #define NUM_SIZES 5
 
+/** Number of option sets the sorting algorithm is tested with. */
+#define NUM_OPTIONS 18
+
+/** Payload moved together with each key when testing key-value sorting. */
+struct record {
+    /** Position of the key in the unsorted array. */
+    long long index;
+    /** Copy of the key. */
+    int key;
+};
+
+/** Bound of the range [-WIDE_RANGE; WIDE_RANGE] used to test sparse values. */
+#define WIDE_RANGE 1000000000
+
+/** Bound of the range [-MID_RANGE; MID_RANGE] used to test wide dense counts. */
+#define MID_RANGE 3000000
+
+/** Arrays longer than this use 64-bit counters in the "Wide Counts" tests. */
+#define WIDE_NARROW_LIMIT 20000
+
+/** Number of times each sort plan is executed. */
+#define PLAN_EXECUTIONS 3
+
+/** Arrays up to this size are expected to be sorted by comparison. */
+#define PLAN_SMALL_SIZE 100
+
+/** Arrays from this size on are expected to be counted with a dense count[]. */
+#define PLAN_LARGE_SIZE 10000000
+
 
 /**
  * @brief Check that all the elements in the array are in the range [min; max].
@@ -47,6 +82,14 @@
  */
 bool elements_in_range(int *array, long long size, int min, int max);
 
+/**
+ * @brief Compute the sum of all the elements in the array.
+ * @param array: The array.
+ * @param size:  Number of elements in the array.
+ * @return Sum of the elements.
+ */
+long long array_sum(int *array, long long size);
+
 /**
  * @brief Test the correct inizialization of the array with random numbers.
  * @param array:    The array.
@@ -71,11 +114,155 @@ void test_init_from_file(int *array, long long size, const char *file_path,
  * @brief Test the correctness of the sorting algorithm.
  * @param array:    The array to sort.
  * @param size:     Size of the array.
+ * @param opts:     Options to sort the array with.
+ * @param name:     Name of the options, shown in the test output.
  * @param num_proc: Number of MPI processes.
  * @param rank:     Rank of the process calling the function.
  */
-void test_sort(int *array, long long size, int num_proc, int rank);
+void test_sort(int *array, long long size, const struct sort_options *opts,
+               const char *name, int num_proc, int rank);
 
+/**
+ * @brief Test the correctness of the sorting algorithm on an array whose values
+ *        are spread over a range much wider than its size.
+ * @param array:    The array to sort.
+ * @param size:     Size of the array.
+ * @param opts:     Options to sort the array with.
+ * @param name:     Name of the options, shown in the test output.
+ * @param num_proc: Number of MPI processes.
+ * @param rank:     Rank of the process calling the function.
+ */
+void test_sort_wide_range(int *array, long long size,
+                          const struct sort_options *opts, const char *name,
+                          int num_proc, int rank);
+
+/**
+ * @brief Test the correctness of the sorting algorithm on an array whose values
+ *        span a range too wide for the cache, but still sorted with a dense
+ *        histogram.
+ * @param array:    The array to sort.
+ * @param size:     Size of the array.
+ * @param opts:     Options to sort the array with.
+ * @param name:     Name of the options, shown in the test output.
+ * @param num_proc: Number of MPI processes.
+ * @param rank:     Rank of the process calling the function.
+ */
+void test_sort_mid_range(int *array, long long size,
+                         const struct sort_options *opts, const char *name,
+                         int num_proc, int rank);
+
+/**
+ * @brief Test the correctness of the sorting algorithm on an array of bytes,
+ *        whose range [0; 255] is given in advance.
+ * @param array:    The array to sort.
+ * @param size:     Size of the array.
+ * @param num_proc: Number of MPI processes.
+ * @param rank:     Rank of the process calling the function.
+ */
+void test_sort_byte_range(int *array, long long size, int num_proc, int rank);
+
+/**
+ * @brief Test the algorithm chosen by the planner and the figures it is based
+ *        on, for an unsorted and then for a sorted array.
+ * @param array:    The array to sort.
+ * @param size:     Size of the array.
+ * @param num_proc: Number of MPI processes.
+ * @param rank:     Rank of the process calling the function.
+ */
+void test_sort_planned(int *array, long long size, int num_proc, int rank);
+
+/**
+ * @brief Test the correctness of the sorting algorithm when the portions of the
+ *        processes are proportional to unequal weights.
+ * @param array:    The array to sort.
+ * @param size:     Size of the array.
+ * @param num_proc: Number of MPI processes.
+ * @param rank:     Rank of the process calling the function.
+ */
+void test_sort_weighted(int *array, long long size, int num_proc, int rank);
+
+/**
+ * @brief Test the correctness of the sorting algorithm on an array where one
+ *        value holds 40% of the elements.
+ * @param array:    The array to sort.
+ * @param size:     Size of the array.
+ * @param opts:     Options to sort the array with.
+ * @param name:     Name of the test, shown in the test output.
+ * @param num_proc: Number of MPI processes.
+ * @param rank:     Rank of the process calling the function.
+ */
+void test_sort_skewed(int *array, long long size,
+                      const struct sort_options *opts, const char *name,
+                      int num_proc, int rank);
+
+/**
+ * @brief Test the correctness of a sort plan executed several times, on new
+ *        elements every time.
+ * @param array:    The array to sort.
+ * @param size:     Size of the array.
+ * @param comm:     Communicator of the processes sharing the plan.
+ * @param name:     Name of the test, shown in the test output.
+ * @param num_proc: Number of MPI processes.
+ * @param rank:     Rank of the process calling the function.
+ */
+void test_sort_plan(int *array, long long size, MPI_Comm comm,
+                    const char *name, int num_proc, int rank);
+
+/**
+ * @brief Test the correctness of the sorting algorithm on an array taken from a
+ *        pre-faulted arena, backed by huge pages when it is large enough.
+ * @param size:     Size of the array.
+ * @param num_proc: Number of MPI processes.
+ * @param rank:     Rank of the process calling the function.
+ */
+void test_sort_huge_pages(long long size, int num_proc, int rank);
+
+/**
+ * @brief Test that the pages of a first-touched array, filled by pinned
+ *        threads, are all found on some NUMA node.
+ * @param size: Size of the array.
+ * @param rank: Rank of the process calling the function.
+ */
+void test_numa_placement(long long size, int rank);
+
+/**
+ * @brief Test the correctness and stability of the sorting algorithm on keys
+ *        carrying a payload.
+ * @param size:     Size of the array.
+ * @param opts:     Options to sort the array with.
+ * @param num_proc: Number of MPI processes.
+ * @param rank:     Rank of the process calling the function.
+ */
+void test_sort_kv(long long size, const struct sort_options *opts,
+                  int num_proc, int rank);
+
+/**
+ * @brief Test the correctness of the sorting algorithm on a distributed array,
+ *        where each process only holds its own portion.
+ * @param size:     Size of the whole array.
+ * @param opts:     Options to sort the array with.
+ * @param name:     Name of the options, shown in the test output.
+ * @param num_proc: Number of MPI processes.
+ * @param rank:     Rank of the process calling the function.
+ */
+void test_sort_distributed(long long size, const struct sort_options *opts,
+                           const char *name, int num_proc, int rank);
+
+
+/**
+ * @brief Test the correctness of the sorting algorithm on an array shared by
+ *        the processes of each node.
+ * @param size:           Size of the whole array.
+ * @param opts:           Options to sort the array with.
+ * @param ranks_per_node: Number of processes taken as a node; 0 to use the
+ *                        actual nodes.
+ * @param name:           Name of the test, shown in the test output.
+ * @param num_proc:       Number of MPI processes.
+ * @param rank:           Rank of the process calling the function.
+ */
+void test_sort_shared(long long size, const struct sort_options *opts,
+                      int ranks_per_node, const char *name, int num_proc,
+                      int rank);
 
 
 int main(int argc, char **argv) {
@@ -85,11 +272,55 @@ int main(int argc, char **argv) {
      * divisible by any number of processes.
      */
     long long sizes[NUM_SIZES] = {10, 6053, 30000, 500009, 20000000};
+    /* Every size is sorted once with each of these sets of options. */
+    struct sort_options opts[NUM_OPTIONS];
+    const char *opts_names[NUM_OPTIONS] = {"Default", "Local Expansion",
+                                           "Sparse Histogram", "Radix",
+                                           "Radix 8 Bits", "Interleaved Kernel",
+                                           "AVX-512 Kernel", "Single Pass",
+                                           "Known Range", "Pipeline",
+                                           "Blocked Kernel", "Prefetch Kernel",
+                                           "Hierarchical, 2 per Node",
+                                           "Comparison", "Sample Sort",
+                                           "Segmented Counts",
+                                           "Hierarchical, NUMA Domains",
+                                           "Wide Counts"};
+    for (int i = 0; i < NUM_OPTIONS; i++)
+        sort_options_init(&opts[i]);
+    opts[1].expand = EXPAND_LOCAL;
+    opts[2].engine = ENGINE_SPARSE;
+    opts[3].engine = ENGINE_RADIX;
+    opts[4].engine = ENGINE_RADIX;
+    opts[4].radix_bits = 8;
+    /* Kernels not supported by the CPU fall back to the scalar one. */
+    opts[5].kernel = KERNEL_INTERLEAVED;
+    opts[6].kernel = KERNEL_AVX512;
+    opts[7].single_pass = true;
+    opts[8].range_known = true;
+    opts[9].pipeline_chunks = 4;
+    opts[10].kernel = KERNEL_BLOCKED;
+    opts[11].kernel = KERNEL_PREFETCH;
+    opts[13].engine = ENGINE_COMPARISON;
+    opts[14].engine = ENGINE_SAMPLE;
+    opts[15].engine = ENGINE_DENSE;
+    opts[15].segmented = true;
+    opts[17].engine = ENGINE_DENSE;
+    opts[17].narrow_limit = WIDE_NARROW_LIMIT;
 
-    MPI_Init(&argc, &argv);
+    /* OpenMP threads never call MPI: only the main thread does. */
+    int thread_support;
+    MPI_Init_thread(&argc, &argv, MPI_THREAD_FUNNELED, &thread_support);
     MPI_Comm_rank(MPI_COMM_WORLD, &rank);
     MPI_Comm_size(MPI_COMM_WORLD, &num_proc);
 
+    /* Pairs of processes are taken as nodes, whatever the actual nodes. */
+    struct topology pairs;
+    topology_create(&pairs, 2, num_proc, rank);
+    opts[12].topology = &pairs;
+    struct topology domains;
+    topology_create(&domains, TOPOLOGY_NUMA, num_proc, rank);
+    opts[16].topology = &domains;
+
     for (int i = 0; i < NUM_SIZES; i++) {
         if (rank == 0) {
             fprintf(stdout, "Testing size %lld (%d/%d) with %d processes...\n",
@@ -100,12 +331,65 @@ int main(int argc, char **argv) {
         int *array = (int *)safe_alloc(sizes[i] * sizeof(int));
         if (argc == 2)
             test_init_from_file(array, sizes[i], argv[1], num_proc, rank);
-        test_init_random(array, sizes[i], num_proc, rank);
-        test_sort(array, sizes[i], num_proc, rank);
+        for (int j = 0; j < NUM_OPTIONS; j++) {
+            test_init_random(array, sizes[i], num_proc, rank);
+            test_sort(array, sizes[i], &opts[j], opts_names[j], num_proc,
+                      rank);
+        }
+        test_sort_distributed(sizes[i], &opts[0], "Distributed", num_proc,
+                              rank);
+        test_sort_distributed(sizes[i], &opts[3], "Distributed Radix",
+                              num_proc, rank);
+        test_sort_distributed(sizes[i], &opts[7], "Distributed Single Pass",
+                              num_proc, rank);
+        test_sort_distributed(sizes[i], &opts[13], "Distributed Comparison",
+                              num_proc, rank);
+        test_sort_distributed(sizes[i], &opts[14], "Distributed Sample Sort",
+                              num_proc, rank);
+        test_sort_distributed(sizes[i], &opts[15],
+                              "Distributed Segmented Counts", num_proc, rank);
+        test_sort_distributed(sizes[i], &opts[17], "Distributed Wide Counts",
+                              num_proc, rank);
+        test_sort_distributed(sizes[i], &opts[12],
+                              "Distributed Hierarchical, 2 per Node", num_proc,
+                              rank);
+        test_sort_distributed(sizes[i], &opts[16],
+                              "Distributed Hierarchical, NUMA Domains",
+                              num_proc, rank);
+        test_sort_shared(sizes[i], &opts[0], 0, "Shared", num_proc, rank);
+        test_sort_shared(sizes[i], &opts[3], 2, "Shared Radix, 2 per Node",
+                         num_proc, rank);
+        test_sort_wide_range(array, sizes[i], &opts[0], "Wide Range",
+                             num_proc, rank);
+        test_sort_wide_range(array, sizes[i], &opts[3], "Wide Range Radix",
+                             num_proc, rank);
+        test_sort_wide_range(array, sizes[i], &opts[7],
+                             "Wide Range Single Pass", num_proc, rank);
+        test_sort_wide_range(array, sizes[i], &opts[14],
+                             "Wide Range Sample Sort", num_proc, rank);
+        test_sort_mid_range(array, sizes[i], &opts[10], "Mid Range Blocked",
+                            num_proc, rank);
+        test_sort_byte_range(array, sizes[i], num_proc, rank);
+        test_sort_skewed(array, sizes[i], &opts[0], "Skewed", num_proc, rank);
+        test_sort_skewed(array, sizes[i], &opts[14], "Skewed Sample Sort",
+                         num_proc, rank);
+        test_sort_skewed(array, sizes[i], &opts[15], "Skewed Segmented Counts",
+                         num_proc, rank);
+        test_sort_weighted(array, sizes[i], num_proc, rank);
+        test_sort_planned(array, sizes[i], num_proc, rank);
+        test_sort_kv(sizes[i], &opts[0], num_proc, rank);
+        test_sort_plan(array, sizes[i], MPI_COMM_WORLD, "Plan", num_proc,
+                       rank);
+        test_sort_plan(array, sizes[i], MPI_COMM_SELF, "Plan, Each Process",
+                       num_proc, rank);
+        test_sort_huge_pages(sizes[i], num_proc, rank);
+        test_numa_placement(sizes[i], rank);
 
         free(array);
     }
 
+    topology_free(&pairs);
+    topology_free(&domains);
     MPI_Finalize();
     return EXIT_SUCCESS;
 }
@@ -120,6 +404,14 @@ bool elements_in_range(int *array, long long size, int min, int max) {
 }
 
 
+long long array_sum(int *array, long long size) {
+    long long sum = 0;
+    for (long long i = 0; i < size; i++)
+        sum += array[i];
+    return sum;
+}
+
+
 void test_init_random(int *array, long long size, int num_proc, int rank) {
     array_init_random(array, size, RANGE_MIN, RANGE_MAX, num_proc, rank);
 
@@ -160,22 +452,401 @@ void test_init_from_file(int *array, long long size, const char *file_path,
 }
 
 
-void test_sort(int *array, long long size, int num_proc, int rank) {
-    counting_sort(array, size, num_proc, rank);
-    MPI_Bcast(array, size, MPI_INT, 0, MPI_COMM_WORLD);
+void test_sort(int *array, long long size, const struct sort_options *opts,
+               const char *name, int num_proc, int rank)
+{
+    long long sum_before = array_sum(array, size);
+    counting_sort_opts(array, size, opts, num_proc, rank);
+
+    /*
+     * Every process checks its own copy of the sorted array: the one gathered
+     * from the portions of all processes.
+     */
+    int local_ok = 1;
+    long long sum_after = array_sum(array, size);
+    if (sum_after != sum_before) {
+        fprintf(stderr, "FAILED Sorting (%s) in process %d!\n"
+                        "The sum of the elements changed from %lld to "
+                        "%lld\n", name, rank, sum_before, sum_after);
+        local_ok = 0;
+    }
 
     /* Check that no element has lesser value than its predecessor. */
-    for (long long i = size - 1; i > 0; i--)
+    for (long long i = size - 1; i > 0 && local_ok; i--)
         if (array[i] < array[i - 1]) {
-            if (rank == 0)
-                fprintf(stderr, "FAILED Sorting!\n"
-                                "array[%lld] %d > %d array[%lld]\n",
-                                i - 1, array[i - 1], array[i], i);
-            free(array);
-            MPI_Barrier(MPI_COMM_WORLD);
-            MPI_Finalize();
-            exit(EXIT_FAILURE);
+            fprintf(stderr, "FAILED Sorting (%s) in process %d!\n"
+                            "array[%lld] %d > %d array[%lld]\n",
+                            name, rank, i - 1, array[i - 1], array[i], i);
+            local_ok = 0;
         }
+
+    int ok = 0;
+    MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (!ok) {
+        free(array);
+        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Finalize();
+        exit(EXIT_FAILURE);
+    }
+    if (rank == 0)
+        fprintf(stdout, "OK Sorting (%s).\n", name);
+}
+
+
+void test_sort_distributed(long long size, const struct sort_options *opts,
+                           const char *name, int num_proc, int rank)
+{
+    long long local_offset = 0, local_size = 0;
+    array_block(size, num_proc, rank, &local_offset, &local_size);
+    int *local_array = (int *)safe_alloc((local_size > 0 ? local_size : 1) *
+                                         sizeof(int));
+    array_init_random_local(local_array, local_size, RANGE_MIN, RANGE_MAX,
+                            rank);
+
+    long long local_sum = array_sum(local_array, local_size);
+    long long sum_before = 0, sum_after = 0;
+    MPI_Allreduce(&local_sum, &sum_before, 1, MPI_LONG_LONG, MPI_SUM,
+                  MPI_COMM_WORLD);
+
+    counting_sort_dist(local_array, local_size, opts, num_proc, rank);
+
+    local_sum = array_sum(local_array, local_size);
+    MPI_Allreduce(&local_sum, &sum_after, 1, MPI_LONG_LONG, MPI_SUM,
+                  MPI_COMM_WORLD);
+
+    /* Check that every portion is sorted. */
+    int local_ok = 1, ok = 0;
+    for (long long i = local_size - 1; i > 0; i--)
+        if (local_array[i] < local_array[i - 1])
+            local_ok = 0;
+
+    /*
+     * Check that every portion starts with an element not lesser than the last
+     * one of the non-empty portions preceding it.
+     */
+    int bounds[2] = {INT_MAX, INT_MIN};
+    if (local_size > 0) {
+        bounds[0] = local_array[0];
+        bounds[1] = local_array[local_size - 1];
+    }
+    int *all_bounds = (int *)safe_alloc(2 * num_proc * sizeof(int));
+    MPI_Allgather(bounds, 2, MPI_INT, all_bounds, 2, MPI_INT, MPI_COMM_WORLD);
+    int last = INT_MIN;
+    for (int i = 0; i < num_proc; i++) {
+        if (all_bounds[2 * i] == INT_MAX && all_bounds[2 * i + 1] == INT_MIN)
+            continue;
+        if (all_bounds[2 * i] < last)
+            local_ok = 0;
+        last = all_bounds[2 * i + 1];
+    }
+    free(all_bounds);
+    free(local_array);
+
+    MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (!ok || sum_before != sum_after) {
+        if (rank == 0)
+            fprintf(stderr, "FAILED Sorting (%s)!\n"
+                            "The distributed array is not sorted or its "
+                            "elements changed\n", name);
+        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Finalize();
+        exit(EXIT_FAILURE);
+    }
+    if (rank == 0)
+        fprintf(stdout, "OK Sorting (%s).\n", name);
+}
+
+
+void test_sort_wide_range(int *array, long long size,
+                          const struct sort_options *opts, const char *name,
+                          int num_proc, int rank)
+{
+    /* Roughly 2 billion possible values: a dense histogram would not fit. */
+    array_init_random(array, size, -WIDE_RANGE, WIDE_RANGE, num_proc, rank);
+    test_sort(array, size, opts, name, num_proc, rank);
+}
+
+
+void test_sort_mid_range(int *array, long long size,
+                         const struct sort_options *opts, const char *name,
+                         int num_proc, int rank)
+{
+    /* Several buckets of the blocked kernel, with negative values too. */
+    array_init_random(array, size, -MID_RANGE, MID_RANGE, num_proc, rank);
+    test_sort(array, size, opts, name, num_proc, rank);
+}
+
+
+void test_sort_byte_range(int *array, long long size, int num_proc, int rank) {
+    struct sort_options opts;
+    sort_options_init(&opts);
+    opts.range_known = true;
+    opts.range_min = 0;
+    opts.range_max = UINT8_MAX;
+
+    array_init_random(array, size, 0, UINT8_MAX, num_proc, rank);
+    test_sort(array, size, &opts, "Byte Range", num_proc, rank);
+}
+
+
+void test_sort_planned(int *array, long long size, int num_proc, int rank) {
+    struct sort_decision unsorted, sorted;
+    struct sort_options opts;
+    sort_options_init(&opts);
+
+    array_init_random(array, size, RANGE_MIN, RANGE_MAX, num_proc, rank);
+    opts.decision = &unsorted;
+    test_sort(array, size, &opts, "Planned", num_proc, rank);
+    opts.decision = &sorted;
+    test_sort(array, size, &opts, "Planned Sorted", num_proc, rank);
+
+    const char *error = NULL;
+    if (unsorted.sample_size <= 0 || unsorted.sample_size > size)
+        error = "the sample is empty or larger than the array";
+    else if (unsorted.distinct < 1 || unsorted.distinct > size ||
+             unsorted.distinct > unsorted.range)
+        error = "the distinct values are more than the elements or the range";
+    else if (unsorted.skew <= 0 || unsorted.skew > 1)
+        error = "the skew is out of (0; 1]";
+    else if (sorted.sortedness != 1)
+        error = "the sorted array is not seen as sorted";
+    else if (size <= PLAN_SMALL_SIZE && unsorted.engine != ENGINE_COMPARISON)
+        error = "a small array is not sorted by comparison";
+    else if (size >= PLAN_LARGE_SIZE && unsorted.engine != ENGINE_DENSE)
+        error = "a large array with a narrow range is not counted densely";
+
+    if (error != NULL) {
+        if (rank == 0)
+            fprintf(stderr, "FAILED Planning!\nWith %lld elements, %s\n",
+                    size, error);
+        free(array);
+        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Finalize();
+        exit(EXIT_FAILURE);
+    }
+    if (rank == 0)
+        fprintf(stdout, "OK Planning (%s).\n",
+                sort_engine_name(unsorted.engine));
+}
+
+
+void test_sort_weighted(int *array, long long size, int num_proc, int rank) {
+    /* Rank i is taken as i + 1 times faster than rank 0. */
+    double *weights = (double *)safe_alloc(num_proc * sizeof(double));
+    for (int i = 0; i < num_proc; i++)
+        weights[i] = i + 1;
+    partition_set_weights(weights, num_proc);
+    free(weights);
+
+    struct sort_options opts;
+    sort_options_init(&opts);
+    array_init_random(array, size, RANGE_MIN, RANGE_MAX, num_proc, rank);
+    test_sort(array, size, &opts, "Weighted", num_proc, rank);
+    test_sort_distributed(size, &opts, "Weighted Distributed", num_proc, rank);
+    test_sort_shared(size, &opts, 0, "Weighted Shared", num_proc, rank);
+
+    partition_set_weights(NULL, num_proc);
+}
+
+
+void test_sort_skewed(int *array, long long size,
+                      const struct sort_options *opts, const char *name,
+                      int num_proc, int rank)
+{
+    array_init_random(array, size, RANGE_MIN, RANGE_MAX, num_proc, rank);
+    /* The same elements are replaced in every process. */
+    for (long long i = 0; i < size; i++)
+        if (i % 5 < 2)
+            array[i] = (RANGE_MIN + RANGE_MAX) / 2;
+    test_sort(array, size, opts, name, num_proc, rank);
+}
+
+
+void test_sort_plan(int *array, long long size, MPI_Comm comm,
+                    const char *name, int num_proc, int rank)
+{
+    struct sort_options opts;
+    sort_options_init(&opts);
+    struct sort_plan plan;
+    sort_plan_create(&plan, array, size, RANGE_MIN, RANGE_MAX, &opts, comm);
+
+    /* All executions are made, since they are collective operations. */
+    int local_ok = 1;
+    for (int run = 0; run < PLAN_EXECUTIONS; run++) {
+        array_init_random(array, size, RANGE_MIN, RANGE_MAX, num_proc, rank);
+        long long sum_before = array_sum(array, size);
+        sort_plan_execute(&plan);
+        local_ok = local_ok && array_sum(array, size) == sum_before;
+        for (long long i = 1; i < size && local_ok; i++)
+            local_ok = array[i - 1] <= array[i];
+    }
+    local_ok = local_ok && plan.executions == PLAN_EXECUTIONS;
+    sort_plan_free(&plan);
+
+    /* Every process checks its own array. */
+    int ok = 0;
+    MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (!ok) {
+        if (rank == 0)
+            fprintf(stderr, "FAILED Sorting (%s)!\n"
+                            "The array is not sorted or its elements changed "
+                            "in some execution\n", name);
+        free(array);
+        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Finalize();
+        exit(EXIT_FAILURE);
+    }
+    if (rank == 0)
+        fprintf(stdout, "OK Sorting (%s).\n", name);
+}
+
+
+void test_sort_huge_pages(long long size, int num_proc, int rank) {
+    /* A byte more than the array, so that the next buffer is aligned. */
+    struct arena arena;
+    arena_create(&arena, size * sizeof(int) + 1 + ARENA_ALIGNMENT, true);
+    int *array = (int *)arena_alloc(&arena, size * sizeof(int) + 1);
+    char *next = (char *)arena_alloc(&arena, 1);
+
+    struct sort_options opts;
+    sort_options_init(&opts);
+    array_init_random(array, size, RANGE_MIN, RANGE_MAX, num_proc, rank);
+    long long sum_before = array_sum(array, size);
+    counting_sort_opts(array, size, &opts, num_proc, rank);
+
+    int local_ok = array_sum(array, size) == sum_before &&
+                   (uintptr_t)next % ARENA_ALIGNMENT == 0;
+    for (long long i = 1; i < size && local_ok; i++)
+        local_ok = array[i - 1] <= array[i];
+    arena_destroy(&arena);
+
+    int ok = 0;
+    MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (!ok) {
+        if (rank == 0)
+            fprintf(stderr, "FAILED Sorting (Huge Pages)!\n"
+                            "The array is not sorted, its elements changed "
+                            "or the arena is misaligned\n");
+        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Finalize();
+        exit(EXIT_FAILURE);
+    }
+    if (rank == 0)
+        fprintf(stdout, "OK Sorting (Huge Pages).\n");
+}
+
+
+void test_numa_placement(long long size, int rank) {
+    /* Pinning can be refused by the system: the placement is checked anyway. */
+    affinity_pin(rank);
+    int *array = (int *)safe_alloc(size * sizeof(int));
+    first_touch(array, size * sizeof(int));
+    array_init_random_local(array, size, RANGE_MIN, RANGE_MAX, rank);
+
+    /* Where move_pages is not available, no page is found at all. */
+    struct numa_balance balance;
+    numa_balance_measure(array, size * sizeof(int), &balance);
+    int local_ok = balance.local + balance.remote + balance.unknown > 0 &&
+                   (balance.unknown == 0 ||
+                    balance.local + balance.remote == 0);
+    free(array);
+
+    int ok = 0;
+    MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    if (!ok) {
+        if (rank == 0)
+            fprintf(stderr, "FAILED NUMA Placement!\n"
+                            "Some pages of a written array are not placed "
+                            "on any node\n");
+        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Finalize();
+        exit(EXIT_FAILURE);
+    }
+    if (rank == 0)
+        fprintf(stdout, "OK NUMA Placement.\n");
+}
+
+
+void test_sort_kv(long long size, const struct sort_options *opts,
+                  int num_proc, int rank)
+{
+    int *keys = (int *)safe_alloc(size * sizeof(int));
+    struct record *records = (struct record *)safe_alloc(size *
+                                                         sizeof(struct record));
+    array_init_random(keys, size, RANGE_MIN, RANGE_MAX, num_proc, rank);
+    for (long long i = 0; i < size; i++) {
+        records[i].index = i;
+        records[i].key = keys[i];
+    }
+
+    counting_sort_kv(keys, records, sizeof(struct record), size, opts,
+                     num_proc, rank);
+
+    /*
+     * Check that keys are sorted, that every payload followed its key and that
+     * payloads with equal keys kept their original order.
+     */
+    bool ok = records[0].key == keys[0];
+    long long index_sum = records[0].index;
+    for (long long i = 1; i < size && ok; i++) {
+        ok = keys[i] >= keys[i - 1] && records[i].key == keys[i] &&
+             (keys[i] != keys[i - 1] || records[i].index > records[i - 1].index);
+        index_sum += records[i].index;
+    }
+    ok = ok && index_sum == size * (size - 1) / 2;
+
+    free(keys);
+    free(records);
+    if (!ok) {
+        if (rank == 0)
+            fprintf(stderr, "FAILED Sorting (Key-Value)!\n"
+                            "The keys are not sorted or their payloads were "
+                            "not moved stably\n");
+        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Finalize();
+        exit(EXIT_FAILURE);
+    }
+    if (rank == 0)
+        fprintf(stdout, "OK Sorting (Key-Value).\n");
+}
+
+
+void test_sort_shared(long long size, const struct sort_options *opts,
+                      int ranks_per_node, const char *name, int num_proc,
+                      int rank)
+{
+    struct node_array array;
+    node_array_alloc(&array, size, ranks_per_node, num_proc, rank);
+
+    long long local_offset = 0, local_size = 0;
+    array_block(size, num_proc, rank, &local_offset, &local_size);
+    array_init_random_local(array.data + local_offset, local_size, RANGE_MIN,
+                            RANGE_MAX, rank);
+    long long local_sum = array_sum(array.data + local_offset, local_size);
+    long long sum_before = 0;
+    MPI_Allreduce(&local_sum, &sum_before, 1, MPI_LONG_LONG, MPI_SUM,
+                  MPI_COMM_WORLD);
+
+    counting_sort_shared(&array, size, opts, num_proc, rank);
+
+    /* Every process checks the whole array, as seen from its node. */
+    int local_ok = array_sum(array.data, size) == sum_before;
+    for (long long i = size - 1; i > 0; i--)
+        if (array.data[i] < array.data[i - 1])
+            local_ok = 0;
+    int ok = 0;
+    MPI_Allreduce(&local_ok, &ok, 1, MPI_INT, MPI_MIN, MPI_COMM_WORLD);
+    node_array_free(&array);
+
+    if (!ok) {
+        if (rank == 0)
+            fprintf(stderr, "FAILED Sorting (%s)!\n"
+                            "The shared array is not sorted or its elements "
+                            "changed\n", name);
+        MPI_Barrier(MPI_COMM_WORLD);
+        MPI_Finalize();
+        exit(EXIT_FAILURE);
+    }
     if (rank == 0)
-        fprintf(stdout, "OK Sorting.\n");
+        fprintf(stdout, "OK Sorting (%s).\n", name);
 }